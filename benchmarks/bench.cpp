@@ -0,0 +1,476 @@
+/// @file bench.cpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief Compares the ordered map against the standard containers.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+/// @details Usage: `ordered_map_bench [--max-size N] [--repeat N] [--linear-limit N]`.
+/// The results are written to the standard output as a JSON document, with
+/// one entry for each container, key type, size and operation, reporting the
+/// best time per operation over the repetitions, in nanoseconds.
+///
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ordered_map/json.hpp"
+#include "ordered_map/ordered_map.hpp"
+
+namespace
+{
+
+/// @brief The options of the benchmark.
+struct options_t {
+    /// @brief The largest size, the sizes go from 10 to this one by powers of ten.
+    std::size_t max_size;
+    /// @brief The number of repetitions of each measure, the best one is kept.
+    std::size_t repeat;
+    /// @brief The largest size for the containers whose search takes linear time.
+    std::size_t linear_limit;
+};
+
+/// @brief A single measure.
+struct result_t {
+    std::string container;
+    std::string key;
+    std::size_t size;
+    std::string operation;
+    std::size_t operations;
+    double ns_per_op;
+};
+
+/// @brief Accumulates the results of the operations, so that they are not optimized away.
+std::size_t sink = 0;
+
+/// @brief Measures the time of a function.
+template <typename Function>
+auto elapsed_ns(Function fun) -> double
+{
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    fun();
+    const std::chrono::steady_clock::time_point stop = std::chrono::steady_clock::now();
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start).count());
+}
+
+/// @brief Builds the keys of the given type, with the given index.
+auto make_int_key(std::size_t index) -> int { return static_cast<int>(index); }
+
+/// @brief Builds short keys, which fit the small string buffer.
+auto make_string_key(std::size_t index) -> std::string { return "k" + std::to_string(index); }
+
+/// @brief Builds 64-byte keys, which differ only at the end.
+auto make_long_key(std::size_t index) -> std::string
+{
+    std::string key = std::to_string(index);
+    return std::string(64 - key.size(), 'k') + key;
+}
+
+/// @brief The ordered map.
+template <typename Key>
+struct ordered_map_adapter_t {
+    using container_t = ordered_map::ordered_map_t<Key, int>;
+
+    static auto name() -> const char * { return "ordered_map_t"; }
+    static auto linear() -> bool { return false; }
+    static void set(container_t &container, const Key &key, int value) { container.set(key, value); }
+    static auto find(const container_t &container, const Key &key) -> bool
+    {
+        return container.find(key) != container.end();
+    }
+    static void erase(container_t &container, const Key &key) { container.erase(key); }
+    static void erase_first(container_t &container) { container.erase(container.begin()); }
+    static auto at(const container_t &container, std::size_t position) -> int
+    {
+        return container.at(position)->second;
+    }
+    static auto descending(const std::pair<Key, int> &lhs, const std::pair<Key, int> &rhs) -> bool
+    {
+        return rhs.first < lhs.first;
+    }
+    static auto sortable() -> bool { return true; }
+    static void sort(container_t &container) { container.sort(descending); }
+};
+
+/// @brief The ordered associative container of the standard library.
+template <typename Key>
+struct map_adapter_t {
+    using container_t = std::map<Key, int>;
+
+    static auto name() -> const char * { return "std::map"; }
+    static auto linear() -> bool { return false; }
+    static void set(container_t &container, const Key &key, int value) { container[key] = value; }
+    static auto find(const container_t &container, const Key &key) -> bool
+    {
+        return container.find(key) != container.end();
+    }
+    static void erase(container_t &container, const Key &key) { container.erase(key); }
+    static void erase_first(container_t &container) { container.erase(container.begin()); }
+    static auto at(const container_t &container, std::size_t position) -> int
+    {
+        return std::next(container.begin(), static_cast<std::ptrdiff_t>(position))->second;
+    }
+    static auto sortable() -> bool { return false; }
+    static void sort(container_t &) {}
+};
+
+/// @brief The unordered associative container of the standard library.
+template <typename Key>
+struct unordered_map_adapter_t {
+    using container_t = std::unordered_map<Key, int>;
+
+    static auto name() -> const char * { return "std::unordered_map"; }
+    static auto linear() -> bool { return false; }
+    static void set(container_t &container, const Key &key, int value) { container[key] = value; }
+    static auto find(const container_t &container, const Key &key) -> bool
+    {
+        return container.find(key) != container.end();
+    }
+    static void erase(container_t &container, const Key &key) { container.erase(key); }
+    static void erase_first(container_t &container) { container.erase(container.begin()); }
+    static auto at(const container_t &container, std::size_t position) -> int
+    {
+        return std::next(container.begin(), static_cast<std::ptrdiff_t>(position))->second;
+    }
+    static auto sortable() -> bool { return false; }
+    static void sort(container_t &) {}
+};
+
+/// @brief A vector of pairs in insertion order, searched linearly.
+template <typename Key>
+struct vector_adapter_t {
+    using container_t = std::vector<std::pair<Key, int>>;
+
+    static auto name() -> const char * { return "std::vector<std::pair>"; }
+    static auto linear() -> bool { return true; }
+    static auto search(const container_t &container, const Key &key) -> typename container_t::const_iterator
+    {
+        return std::find_if(container.begin(), container.end(),
+                            [&key](const std::pair<Key, int> &entry) { return entry.first == key; });
+    }
+    static void set(container_t &container, const Key &key, int value)
+    {
+        typename container_t::const_iterator it = search(container, key);
+        if (it == container.end()) {
+            container.emplace_back(key, value);
+        } else {
+            container[static_cast<std::size_t>(it - container.begin())].second = value;
+        }
+    }
+    static auto find(const container_t &container, const Key &key) -> bool
+    {
+        return search(container, key) != container.end();
+    }
+    static void erase(container_t &container, const Key &key)
+    {
+        typename container_t::const_iterator it = search(container, key);
+        if (it != container.end()) {
+            container.erase(container.begin() + (it - container.begin()));
+        }
+    }
+    static void erase_first(container_t &container) { container.erase(container.begin()); }
+    static auto at(const container_t &container, std::size_t position) -> int { return container[position].second; }
+    static auto sortable() -> bool { return true; }
+    static void sort(container_t &container)
+    {
+        std::sort(container.begin(), container.end(), [](const std::pair<Key, int> &lhs, const std::pair<Key, int> &rhs) {
+            return rhs.first < lhs.first;
+        });
+    }
+};
+
+/// @brief Runs a measure, repeating it and keeping the best time.
+/// @param setup builds the input of the measure, which is not timed.
+/// @param body the measured function, called on the input.
+template <typename Input, typename Setup, typename Body>
+auto best_of(const options_t &options, Setup setup, Body body) -> double
+{
+    double best = 0;
+    for (std::size_t repetition = 0; repetition < options.repeat; ++repetition) {
+        Input input          = setup();
+        const double elapsed = elapsed_ns([&input, &body]() { body(input); });
+        best                 = (repetition == 0) ? elapsed : std::min(best, elapsed);
+    }
+    return best;
+}
+
+/// @brief Measures all the operations of a container, with the given keys.
+template <typename Adapter, typename Key>
+void run_container(const options_t &options,
+                   const std::string &key_name,
+                   const std::vector<Key> &keys,
+                   const std::vector<Key> &misses,
+                   std::vector<result_t> &results)
+{
+    using container_t      = typename Adapter::container_t;
+    const std::size_t size = keys.size();
+    if (Adapter::linear() && (size > options.linear_limit)) {
+        return;
+    }
+    auto record            = [&](const char *operation, std::size_t operations, double elapsed) {
+        result_t result;
+        result.container  = Adapter::name();
+        result.key        = key_name;
+        result.size       = size;
+        result.operation  = operation;
+        result.operations = operations;
+        result.ns_per_op  = elapsed / static_cast<double>(std::max<std::size_t>(operations, 1));
+        results.push_back(result);
+    };
+    auto empty = []() { return container_t(); };
+    auto full  = [&keys]() {
+        container_t container;
+        for (std::size_t index = 0; index < keys.size(); ++index) {
+            Adapter::set(container, keys[index], static_cast<int>(index));
+        }
+        return container;
+    };
+    record("set", size, best_of<container_t>(options, empty, [&keys](container_t &container) {
+               for (std::size_t index = 0; index < keys.size(); ++index) {
+                   Adapter::set(container, keys[index], static_cast<int>(index));
+               }
+           }));
+    const container_t container = full();
+    record("find_hit", size, best_of<int>(options, []() { return 0; }, [&](int) {
+               for (const Key &key : keys) {
+                   sink += Adapter::find(container, key) ? 1U : 0U;
+               }
+           }));
+    record("find_miss", size, best_of<int>(options, []() { return 0; }, [&](int) {
+               for (const Key &key : misses) {
+                   sink += Adapter::find(container, key) ? 1U : 0U;
+               }
+           }));
+    record("erase_key", size, best_of<container_t>(options, full, [&keys](container_t &input) {
+               for (const Key &key : keys) {
+                   Adapter::erase(input, key);
+               }
+           }));
+    record("erase_iterator", size, best_of<container_t>(options, full, [](container_t &input) {
+               while (input.size() > 0) {
+                   Adapter::erase_first(input);
+               }
+           }));
+    // Positional access is linear on the node-based containers, so only some positions are sampled.
+    const std::size_t samples = std::min<std::size_t>(size, 100);
+    record("at", samples, best_of<int>(options, []() { return 0; }, [&](int) {
+               for (std::size_t sample = 0; sample < samples; ++sample) {
+                   sink += static_cast<std::size_t>(Adapter::at(container, (sample * 7919) % size));
+               }
+           }));
+    record("iterate", size, best_of<int>(options, []() { return 0; }, [&](int) {
+               for (const auto &entry : container) {
+                   sink += static_cast<std::size_t>(entry.second);
+               }
+           }));
+    if (Adapter::sortable()) {
+        record("sort", size, best_of<container_t>(options, full, [](container_t &input) { Adapter::sort(input); }));
+    }
+    record("copy", size, best_of<int>(options, []() { return 0; }, [&](int) {
+               container_t copy(container);
+               sink += copy.size();
+           }));
+}
+
+/// @brief Writes the map as a JSON object through `operator<<`, without
+/// escaping, as a baseline for `json_writer_t`.
+void write_json_ostream(std::ostream &stream, const ordered_map::ordered_map_t<std::string, int> &map)
+{
+    stream << '{';
+    bool first = true;
+    for (const auto &entry : map) {
+        stream << (first ? "\"" : ",\"") << entry.first << "\":" << entry.second;
+        first = false;
+    }
+    stream << '}';
+}
+
+/// @brief Reads a JSON object written by `write_json_ostream` through
+/// `operator>>` and repeated calls to `set`, as a baseline for `read_json`.
+void read_json_istream(std::istream &stream, ordered_map::ordered_map_t<std::string, int> &map)
+{
+    std::string key;
+    int value      = 0;
+    char separator = 0;
+    stream >> separator;
+    while ((stream >> separator) && (separator == '"')) {
+        std::getline(stream, key, '"');
+        stream >> separator >> value >> separator;
+        map.set(key, value);
+        if (separator != ',') {
+            break;
+        }
+    }
+}
+
+/// @brief Measures the JSON reader and writer, on a map with string keys,
+/// against a baseline using the standard streams and repeated calls to `set`.
+void run_json(const options_t &options,
+              const std::string &key_name,
+              const std::vector<std::string> &keys,
+              std::vector<result_t> &results)
+{
+    ordered_map::ordered_map_t<std::string, int> map;
+    for (std::size_t index = 0; index < keys.size(); ++index) {
+        map.set(keys[index], static_cast<int>(index));
+    }
+    std::ostringstream document;
+    ordered_map::write_json(document, map);
+    const std::string text = document.str();
+    result_t result;
+    result.container  = "ordered_map_t";
+    result.key        = key_name;
+    result.size       = keys.size();
+    result.operations = keys.size();
+    result.operation  = "json_write";
+    ordered_map::json_writer_t writer;
+    result.ns_per_op = best_of<int>(options, []() { return 0; }, [&](int) { sink += writer.write(map).size(); }) /
+                       static_cast<double>(keys.size());
+    results.push_back(result);
+    result.operation = "json_read";
+    result.ns_per_op = best_of<int>(options, []() { return 0; }, [&](int) {
+                           std::istringstream stream(text);
+                           ordered_map::ordered_map_t<std::string, int> loaded;
+                           ordered_map::read_json(stream, loaded);
+                           sink += loaded.size();
+                       }) /
+                       static_cast<double>(keys.size());
+    results.push_back(result);
+    result.operation = "json_write_ostream";
+    result.ns_per_op = best_of<int>(options, []() { return 0; }, [&](int) {
+                           std::ostringstream stream;
+                           write_json_ostream(stream, map);
+                           sink += stream.str().size();
+                       }) /
+                       static_cast<double>(keys.size());
+    results.push_back(result);
+    result.operation = "json_read_istream";
+    result.ns_per_op = best_of<int>(options, []() { return 0; }, [&](int) {
+                           std::istringstream stream(text);
+                           ordered_map::ordered_map_t<std::string, int> loaded;
+                           read_json_istream(stream, loaded);
+                           sink += loaded.size();
+                       }) /
+                       static_cast<double>(keys.size());
+    results.push_back(result);
+}
+
+/// @brief Measures all the containers, with keys built by the given function.
+template <typename Key>
+void run_keys(const options_t &options,
+              const std::string &key_name,
+              Key (*make_key)(std::size_t),
+              std::vector<result_t> &results)
+{
+    std::mt19937_64 generator(42);
+    for (std::size_t size = 10; size <= options.max_size; size *= 10) {
+        // Even indices are inserted in random order, odd ones are the misses.
+        std::vector<Key> keys;
+        std::vector<Key> misses;
+        keys.reserve(size);
+        misses.reserve(size);
+        for (std::size_t index = 0; index < size; ++index) {
+            keys.push_back(make_key(2 * index));
+            misses.push_back(make_key((2 * index) + 1));
+        }
+        std::shuffle(keys.begin(), keys.end(), generator);
+        std::shuffle(misses.begin(), misses.end(), generator);
+        run_container<ordered_map_adapter_t<Key>>(options, key_name, keys, misses, results);
+        run_container<map_adapter_t<Key>>(options, key_name, keys, misses, results);
+        run_container<unordered_map_adapter_t<Key>>(options, key_name, keys, misses, results);
+        run_container<vector_adapter_t<Key>>(options, key_name, keys, misses, results);
+        std::cerr << key_name << " " << size << " done\n";
+    }
+}
+
+/// @brief Measures the JSON reader and writer, for the key types which are strings.
+void run_json_keys(const options_t &options,
+                   const std::string &key_name,
+                   std::string (*make_key)(std::size_t),
+                   std::vector<result_t> &results)
+{
+    for (std::size_t size = 10; size <= options.max_size; size *= 10) {
+        std::vector<std::string> keys;
+        keys.reserve(size);
+        for (std::size_t index = 0; index < size; ++index) {
+            keys.push_back(make_key(index));
+        }
+        run_json(options, key_name, keys, results);
+    }
+}
+
+/// @brief Writes the results as a JSON document.
+void print_results(const options_t &options, const std::vector<result_t> &results)
+{
+    std::cout << "{\n";
+    std::cout << "  \"benchmark\": \"ordered_map_bench\",\n";
+    std::cout << "  \"format\": 1,\n";
+    std::cout << "  \"repeat\": " << options.repeat << ",\n";
+    std::cout << "  \"results\": [";
+    for (std::size_t index = 0; index < results.size(); ++index) {
+        const result_t &result = results[index];
+        std::ostringstream line;
+        line.precision(6);
+        line << std::fixed << result.ns_per_op;
+        std::cout << ((index == 0) ? "\n" : ",\n") << "    {\"container\": \"" << result.container
+                  << "\", \"key\": \"" << result.key << "\", \"size\": " << result.size << ", \"operation\": \""
+                  << result.operation << "\", \"operations\": " << result.operations
+                  << ", \"ns_per_op\": " << line.str() << "}";
+    }
+    std::cout << "\n  ]\n}\n";
+}
+
+/// @brief Parses a positive number from the command line.
+auto parse_size(const char *argument) -> std::size_t
+{
+    char *end                 = nullptr;
+    const unsigned long value = std::strtoul(argument, &end, 10);
+    if ((end == argument) || (*end != '\0') || (value == 0)) {
+        std::cerr << "Invalid number: " << argument << "\n";
+        std::exit(1);
+    }
+    return static_cast<std::size_t>(value);
+}
+
+} // namespace
+
+auto main(int argc, char *argv[]) -> int
+{
+    options_t options;
+    options.max_size     = 1000000;
+    options.repeat       = 3;
+    options.linear_limit = 10000;
+    for (int index = 1; index < argc; ++index) {
+        if ((std::strcmp(argv[index], "--max-size") == 0) && (index + 1 < argc)) {
+            options.max_size = parse_size(argv[++index]);
+        } else if ((std::strcmp(argv[index], "--repeat") == 0) && (index + 1 < argc)) {
+            options.repeat = parse_size(argv[++index]);
+        } else if ((std::strcmp(argv[index], "--linear-limit") == 0) && (index + 1 < argc)) {
+            options.linear_limit = parse_size(argv[++index]);
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--max-size N] [--repeat N] [--linear-limit N]\n";
+            return 1;
+        }
+    }
+    std::vector<result_t> results;
+    run_keys<int>(options, "int", make_int_key, results);
+    run_keys<std::string>(options, "string", make_string_key, results);
+    run_keys<std::string>(options, "string64", make_long_key, results);
+    run_json_keys(options, "string", make_string_key, results);
+    run_json_keys(options, "string64", make_long_key, results);
+    print_results(options, results);
+    std::cerr << "checksum " << sink << "\n";
+    return 0;
+}
@@ -0,0 +1,269 @@
+/// @file append_only_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A lock-free, append-only, version of the ordered map.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+namespace ordered_map
+{
+
+/// @brief An ordered map where keys can only be added, and values updated in
+/// place, by any number of threads without locks.
+/// @details Each new key reserves a slot with an atomic increment, thus, the
+/// insertion order is the order of the slots. Slots live inside segments of
+/// growing size, which are allocated on demand and never moved. The keys are
+/// published into an open-addressing index with a compare-and-swap. When two
+/// threads append the same key at the same time, only one of them wins the
+/// index, the slot of the other one is marked as dead and skipped by the
+/// iteration. Values must be trivially copyable, since they are stored as
+/// `std::atomic<Value>` to allow concurrent updates and reads.
+/// @tparam Key the type of the key.
+/// @tparam Value the value stored inside the map, it must be trivially copyable.
+/// @tparam Hash the hash function used to index the keys.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class append_only_ordered_map_t
+{
+    static_assert(std::is_trivially_copyable<Value>::value, "The value must be trivially copyable.");
+
+public:
+    /// @brief Construct a new, empty, map.
+    /// @param max_keys the maximum number of keys (including dead slots).
+    explicit append_only_ordered_map_t(std::size_t max_keys)
+        : capacity(max_keys)
+        , mask()
+        , reserved(0)
+        , live(0)
+        , index(nullptr)
+        , segments()
+        , hasher()
+    {
+        std::size_t table_size = 16;
+        while (table_size < (capacity * 2)) {
+            table_size <<= 1U;
+        }
+        mask  = table_size - 1;
+        index = new std::atomic<std::size_t>[table_size]();
+        for (std::atomic<slot_t *> &segment : segments) {
+            segment.store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    /// @brief Destroys the map, no other thread must be using it.
+    ~append_only_ordered_map_t()
+    {
+        std::size_t count = std::min(reserved.load(), capacity);
+        for (std::size_t position = 0; position < count; ++position) {
+            slot_t *slot = this->slot_at(position);
+            if ((slot != nullptr) && (slot->state.load() != state_empty)) {
+                slot->key()->~Key();
+            }
+        }
+        for (std::atomic<slot_t *> &segment : segments) {
+            delete[] segment.load();
+        }
+        delete[] index;
+    }
+
+    append_only_ordered_map_t(const append_only_ordered_map_t &)                     = delete;
+    append_only_ordered_map_t(append_only_ordered_map_t &&)                          = delete;
+    auto operator=(const append_only_ordered_map_t &) -> append_only_ordered_map_t & = delete;
+    auto operator=(append_only_ordered_map_t &&) -> append_only_ordered_map_t &      = delete;
+
+    /// @brief Returns the number of keys in the map.
+    /// @return the number of keys.
+    auto size() const -> std::size_t { return live.load(std::memory_order_acquire); }
+
+    /// @brief Sets/updates the `<key,value>` pair inside the map.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    /// @return true if the key was appended, false if it was updated.
+    /// @throws std::length_error if all the slots are used.
+    auto set(const Key &key, const Value &value) -> bool
+    {
+        slot_t *existing = this->lookup(key);
+        if (existing != nullptr) {
+            existing->value.store(value, std::memory_order_release);
+            return false;
+        }
+        // Reserve a new slot, its position is the insertion order.
+        std::size_t position = reserved.fetch_add(1, std::memory_order_relaxed);
+        if (position >= capacity) {
+            throw std::length_error("append_only_ordered_map_t: the map is full");
+        }
+        slot_t *slot = this->allocate_slot(position);
+        new (slot->key()) Key(key);
+        slot->value.store(value, std::memory_order_relaxed);
+        // Publish the slot inside the index.
+        std::size_t hash = this->home_of(key);
+        for (;; hash = (hash + 1) & mask) {
+            std::size_t expected = 0;
+            if (index[hash].compare_exchange_strong(expected, position + 1, std::memory_order_acq_rel)) {
+                slot->state.store(state_live, std::memory_order_release);
+                live.fetch_add(1, std::memory_order_release);
+                return true;
+            }
+            slot_t &other = this->published_slot(expected - 1);
+            if (*other.key() == key) {
+                // Another thread appended the same key first.
+                slot->state.store(state_dead, std::memory_order_release);
+                other.value.store(value, std::memory_order_release);
+                return false;
+            }
+        }
+    }
+
+    /// @brief Copies the value associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @param value where the value is copied, if found.
+    /// @return true if the key was found, false otherwise.
+    auto find(const Key &key, Value &value) const -> bool
+    {
+        slot_t *slot = this->lookup(key);
+        if (slot == nullptr) {
+            return false;
+        }
+        value = slot->value.load(std::memory_order_acquire);
+        return true;
+    }
+
+    /// @brief Calls the given function on each element, following the insertion order.
+    /// @details Keys appended concurrently might or might not be visited.
+    /// @param fun the function, called as `fun(const Key &, const Value &)`.
+    template <typename Function>
+    void for_each(Function fun) const
+    {
+        std::size_t count = std::min(reserved.load(std::memory_order_acquire), capacity);
+        for (std::size_t position = 0; position < count; ++position) {
+            slot_t *slot = this->slot_at(position);
+            if ((slot != nullptr) && (slot->state.load(std::memory_order_acquire) == state_live)) {
+                const Value value = slot->value.load(std::memory_order_acquire);
+                fun(*slot->key(), value);
+            }
+        }
+    }
+
+private:
+    /// @brief The slot is reserved, but its key is not published yet.
+    static constexpr unsigned char state_empty = 0;
+    /// @brief The slot contains a published key.
+    static constexpr unsigned char state_live  = 1;
+    /// @brief The slot lost the race against another slot with the same key.
+    static constexpr unsigned char state_dead  = 2;
+    /// @brief The number of slots of the first segment.
+    static constexpr std::size_t first_segment = 64;
+
+    /// @brief A slot of the storage.
+    struct slot_t {
+        /// @brief Returns the key stored inside the slot.
+        auto key() -> Key * { return reinterpret_cast<Key *>(&storage); }
+
+        /// @brief The storage for the key.
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type storage;
+        /// @brief The value.
+        std::atomic<Value> value;
+        /// @brief The state of the slot.
+        std::atomic<unsigned char> state;
+    };
+
+    /// @brief Computes the segment and the offset of the given position.
+    static auto locate(std::size_t position, std::size_t &offset) -> std::size_t
+    {
+        std::size_t segment = 0;
+        std::size_t size    = first_segment;
+        while (position >= size) {
+            position -= size;
+            size <<= 1U;
+            ++segment;
+        }
+        offset = position;
+        return segment;
+    }
+
+    /// @brief Returns the slot in the given position, or null if its segment
+    /// is not allocated yet.
+    auto slot_at(std::size_t position) const -> slot_t *
+    {
+        std::size_t offset  = 0;
+        std::size_t segment = append_only_ordered_map_t::locate(position, offset);
+        slot_t *slots       = segments[segment].load(std::memory_order_acquire);
+        return (slots != nullptr) ? (slots + offset) : nullptr;
+    }
+
+    /// @brief Returns the slot in the given position, which has been
+    /// published inside the index, so its segment is allocated.
+    auto published_slot(std::size_t position) const -> slot_t &
+    {
+        std::size_t offset  = 0;
+        std::size_t segment = append_only_ordered_map_t::locate(position, offset);
+        return segments[segment].load(std::memory_order_acquire)[offset];
+    }
+
+    /// @brief Returns the slot in the given position, allocating its segment if needed.
+    auto allocate_slot(std::size_t position) -> slot_t *
+    {
+        std::size_t offset  = 0;
+        std::size_t segment = append_only_ordered_map_t::locate(position, offset);
+        slot_t *slots       = segments[segment].load(std::memory_order_acquire);
+        if (slots == nullptr) {
+            auto *created = new slot_t[first_segment << segment]();
+            if (segments[segment].compare_exchange_strong(slots, created, std::memory_order_acq_rel)) {
+                slots = created;
+            } else {
+                delete[] created;
+            }
+        }
+        return slots + offset;
+    }
+
+    /// @brief Returns the first slot of the index to probe for the given key.
+    auto home_of(const Key &key) const -> std::size_t
+    {
+        auto value = static_cast<std::uint64_t>(hasher(key));
+        value      = (value ^ (value >> 31U)) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<std::size_t>(value >> 32U) & mask;
+    }
+
+    /// @brief Searches the slot of the given key.
+    auto lookup(const Key &key) const -> slot_t *
+    {
+        for (std::size_t hash = this->home_of(key);; hash = (hash + 1) & mask) {
+            std::size_t entry = index[hash].load(std::memory_order_acquire);
+            if (entry == 0) {
+                return nullptr;
+            }
+            slot_t &slot = this->published_slot(entry - 1);
+            if (*slot.key() == key) {
+                return &slot;
+            }
+        }
+    }
+
+    /// @brief The maximum number of slots.
+    std::size_t capacity;
+    /// @brief The mask used to wrap the indices around the index.
+    std::size_t mask;
+    /// @brief The number of reserved slots.
+    std::atomic<std::size_t> reserved;
+    /// @brief The number of published keys.
+    std::atomic<std::size_t> live;
+    /// @brief The index, each entry stores the position of a slot plus one.
+    std::atomic<std::size_t> *index;
+    /// @brief The segments, the i-th one has `first_segment << i` slots.
+    std::atomic<slot_t *> segments[sizeof(std::size_t) * 8];
+    /// @brief The hash function.
+    Hash hasher;
+};
+
+} // namespace ordered_map
@@ -0,0 +1,134 @@
+/// @file codec.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief The codecs used to serialize keys and values of the ordered map.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+/// @details A codec is a specialization of `codec_t<T>` providing:
+///  - `static void encode(std::ostream &, const T &)`;
+///  - `static void decode(std::istream &, T &)`, which throws a
+///    `std::runtime_error` when the stream does not contain a valid `T`.
+///
+/// Trivially copyable types and `std::string` are supported out of the box.
+/// The codecs deriving from `raw_codec_t<T>` store exactly `sizeof(T)` bytes,
+/// which allows the map to copy whole blocks of entries with `memcpy`.
+///
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+namespace ordered_map
+{
+
+namespace detail
+{
+
+/// @brief Reads exactly the given number of bytes from the stream.
+/// @param stream the input stream.
+/// @param data where the bytes are stored.
+/// @param size the number of bytes.
+/// @throws std::runtime_error if the stream ends before.
+inline void read_bytes(std::istream &stream, void *data, std::size_t size)
+{
+    if (!stream.read(static_cast<char *>(data), static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("ordered_map: unexpected end of stream");
+    }
+}
+
+/// @brief Writes the given bytes to the stream.
+/// @param stream the output stream.
+/// @param data the bytes.
+/// @param size the number of bytes.
+/// @throws std::runtime_error if the stream fails.
+inline void write_bytes(std::ostream &stream, const void *data, std::size_t size)
+{
+    if (!stream.write(static_cast<const char *>(data), static_cast<std::streamsize>(size))) {
+        throw std::runtime_error("ordered_map: failed to write the stream");
+    }
+}
+
+} // namespace detail
+
+/// @brief Stores the object representation of a trivially copyable type.
+/// @tparam T the type, which must be trivially copyable.
+template <typename T>
+struct raw_codec_t {
+    static_assert(std::is_trivially_copyable<T>::value, "raw_codec_t requires a trivially copyable type");
+
+    /// @brief Writes the value.
+    /// @param stream the output stream.
+    /// @param value the value.
+    static void encode(std::ostream &stream, const T &value) { detail::write_bytes(stream, &value, sizeof(T)); }
+
+    /// @brief Reads the value.
+    /// @param stream the input stream.
+    /// @param value where the value is stored.
+    static void decode(std::istream &stream, T &value) { detail::read_bytes(stream, &value, sizeof(T)); }
+};
+
+/// @brief The codec of a type, specialize it to support new types.
+/// @tparam T the type.
+template <typename T, typename Enable = void>
+struct codec_t;
+
+/// @brief Trivially copyable types are stored as they are.
+template <typename T>
+struct codec_t<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type> : raw_codec_t<T> {
+};
+
+/// @brief Strings are stored as their length, followed by their characters.
+template <>
+struct codec_t<std::string> {
+    /// @brief Writes the string.
+    /// @param stream the output stream.
+    /// @param value the string.
+    static void encode(std::ostream &stream, const std::string &value)
+    {
+        const auto length = static_cast<std::uint64_t>(value.size());
+        detail::write_bytes(stream, &length, sizeof(length));
+        detail::write_bytes(stream, value.data(), value.size());
+    }
+
+    /// @brief Reads the string.
+    /// @param stream the input stream.
+    /// @param value where the string is stored.
+    static void decode(std::istream &stream, std::string &value)
+    {
+        std::uint64_t length = 0;
+        detail::read_bytes(stream, &length, sizeof(length));
+        // Grow while reading, so that a corrupted length cannot exhaust the memory.
+        value.clear();
+        char buffer[4096];
+        while (length > 0) {
+            const auto chunk = static_cast<std::size_t>(std::min<std::uint64_t>(length, sizeof(buffer)));
+            detail::read_bytes(stream, buffer, chunk);
+            value.append(buffer, chunk);
+            length -= chunk;
+        }
+    }
+};
+
+/// @brief Checks if the codec of a type stores its object representation.
+/// @tparam T the type.
+template <typename T>
+struct is_raw_codec : std::is_base_of<raw_codec_t<T>, codec_t<T>> {
+};
+
+/// @brief Checks if the codecs of both the key and the value store their
+/// object representation, so that whole entries can be copied at once.
+/// @tparam Key the type of the key.
+/// @tparam Value the type of the value.
+template <typename Key, typename Value>
+struct is_raw_entry : std::integral_constant<bool, is_raw_codec<Key>::value && is_raw_codec<Value>::value> {
+};
+
+} // namespace ordered_map
@@ -0,0 +1,271 @@
+/// @file concurrent_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A sharded version of the ordered map, which can be used concurrently.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_map/ordered_map.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ordered_map
+{
+
+/// @brief An ordered map which can be used concurrently by multiple threads.
+/// @details The keys are partitioned across several shards, each one with its
+/// own lock and its own `ordered_map_t`. Threads working on keys of different
+/// shards do not contend. Each new key receives a number from a global
+/// sequence, which is used to merge the shards following the insertion order.
+/// @tparam Key the type of the key.
+/// @tparam Value the value stored inside the map.
+/// @tparam Hash the hash function used to select the shard of a key.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class concurrent_ordered_map_t
+{
+public:
+    /// @brief This stores the key->value association.
+    using list_entry_t = std::pair<Key, Value>;
+    /// @brief The map built when merging the shards.
+    using map_t        = ordered_map_t<Key, Value>;
+
+    /// @brief Construct a new concurrent ordered map.
+    /// @param shard_count the number of shards, by default it is four times
+    /// the number of hardware threads.
+    explicit concurrent_ordered_map_t(std::size_t shard_count = 0)
+        : shards(concurrent_ordered_map_t::default_shard_count(shard_count))
+        , sequence(0)
+        , hasher()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Returns the number of shards.
+    /// @return the number of shards.
+    auto shard_count() const -> std::size_t { return shards.size(); }
+
+    /// @brief Returns the number of element in the map.
+    /// @details Each shard is locked in turn, so the result is exact only
+    /// when no other thread is modifying the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t
+    {
+        std::size_t count = 0;
+        for (const shard_t &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            count += shard.map.size();
+        }
+        return count;
+    }
+
+    /// @brief Sets/updates the `<key,value>` pair inside the map.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    /// @return true if the key was inserted, false if it was updated.
+    auto set(const Key &key, const Value &value) -> bool
+    {
+        shard_t &shard = this->shard_of(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        typename shard_map_t::iterator it = shard.map.find(key);
+        if (it != shard.map.end()) {
+            it->second.second = value;
+            return false;
+        }
+        shard.map.set(key, std::make_pair(sequence.fetch_add(1, std::memory_order_relaxed), value));
+        return true;
+    }
+
+    /// @brief Copies the value associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @param value where the value is copied, if found.
+    /// @return true if the key was found, false otherwise.
+    auto find(const Key &key, Value &value) const -> bool
+    {
+        const shard_t &shard = this->shard_of(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        typename shard_map_t::const_iterator it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            return false;
+        }
+        value = it->second.second;
+        return true;
+    }
+
+    /// @brief Checks if the given key is inside the map.
+    /// @param key the key of the element to search for.
+    /// @return true if the key was found, false otherwise.
+    auto contains(const Key &key) const -> bool
+    {
+        const shard_t &shard = this->shard_of(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        return shard.map.find(key) != shard.map.end();
+    }
+
+    /// @brief Calls the given function on the value associated with the key,
+    /// while holding the lock of its shard.
+    /// @param key the key of the element to search for.
+    /// @param fun the function, called as `fun(Value &)`.
+    /// @return true if the key was found, false otherwise.
+    template <typename Function>
+    auto visit(const Key &key, Function fun) -> bool
+    {
+        shard_t &shard = this->shard_of(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        typename shard_map_t::iterator it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            return false;
+        }
+        fun(it->second.second);
+        return true;
+    }
+
+    /// @brief Erases the element associated with the given key.
+    /// @param key the key of the element to remove.
+    /// @return true if the element was removed, false otherwise.
+    auto erase(const Key &key) -> bool
+    {
+        shard_t &shard = this->shard_of(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        std::size_t previous = shard.map.size();
+        shard.map.erase(key);
+        return shard.map.size() != previous;
+    }
+
+    /// @brief Clears the content of the map.
+    void clear()
+    {
+        for (shard_t &shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.map.clear();
+        }
+    }
+
+    /// @brief Merges the shards into an ordered map, following the insertion order.
+    /// @details All the shards are locked (always in the same order) while the
+    /// content is copied, so the result is a consistent point-in-time view.
+    /// The index of the result is built with `append` after the locks are
+    /// released, since the shards never share a key.
+    /// @return the ordered map.
+    auto snapshot() const -> map_t
+    {
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(shards.size());
+        for (const shard_t &shard : shards) {
+            locks.emplace_back(shard.mutex);
+        }
+        // Each shard follows the sequence order, so we merge them with a heap.
+        using cursor_t = std::pair<typename shard_map_t::const_iterator, typename shard_map_t::const_iterator>;
+        std::vector<cursor_t> heap;
+        heap.reserve(shards.size());
+        std::size_t count = 0;
+        for (const shard_t &shard : shards) {
+            count += shard.map.size();
+            if (shard.map.begin() != shard.map.end()) {
+                heap.emplace_back(shard.map.begin(), shard.map.end());
+            }
+        }
+        // The heap keeps on top the cursor with the lowest sequence number.
+        auto later = [](const cursor_t &lhs, const cursor_t &rhs) {
+            return lhs.first->second.first > rhs.first->second.first;
+        };
+        std::make_heap(heap.begin(), heap.end(), later);
+        std::vector<list_entry_t> entries;
+        entries.reserve(count);
+        while (!heap.empty()) {
+            std::pop_heap(heap.begin(), heap.end(), later);
+            cursor_t &cursor = heap.back();
+            entries.emplace_back(cursor.first->first, cursor.first->second.second);
+            if (++cursor.first == cursor.second) {
+                heap.pop_back();
+            } else {
+                std::push_heap(heap.begin(), heap.end(), later);
+            }
+        }
+        locks.clear();
+        map_t result;
+        result.append(std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+        return result;
+    }
+
+    /// @brief Calls the given function on each element, following the insertion order.
+    /// @details The function is called on a snapshot of the map (see `snapshot`).
+    /// @param fun the function, called as `fun(const list_entry_t &)`.
+    template <typename Function>
+    void for_each(Function fun) const
+    {
+        map_t merged = this->snapshot();
+        for (const list_entry_t &entry : merged) {
+            fun(entry);
+        }
+    }
+
+private:
+    /// @brief Each key is associated with its sequence number and its value.
+    using shard_map_t = ordered_map_t<Key, std::pair<std::uint64_t, Value>>;
+
+    /// @brief A shard of the map.
+    struct shard_t {
+        /// @brief Construct a new empty shard.
+        shard_t()
+            : mutex()
+            , map()
+            , padding()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief The lock protecting the shard.
+        mutable std::mutex mutex;
+        /// @brief The content of the shard.
+        shard_map_t map;
+        /// @brief Keeps adjacent shards on different cache lines.
+        char padding[64];
+    };
+
+    /// @brief Computes the number of shards.
+    /// @param requested the requested number of shards, zero for the default.
+    /// @return the number of shards.
+    static auto default_shard_count(std::size_t requested) -> std::size_t
+    {
+        if (requested > 0) {
+            return requested;
+        }
+        std::size_t threads = std::thread::hardware_concurrency();
+        return std::max<std::size_t>(threads, 1) * 4;
+    }
+
+    /// @brief Returns the shard of the given key.
+    auto shard_of(const Key &key) -> shard_t & { return shards[this->index_of(key)]; }
+
+    /// @brief Returns the shard of the given key.
+    auto shard_of(const Key &key) const -> const shard_t & { return shards[this->index_of(key)]; }
+
+    /// @brief Returns the index of the shard of the given key.
+    auto index_of(const Key &key) const -> std::size_t
+    {
+        // Mix the bits, since many standard hashes are the identity.
+        auto value = static_cast<std::uint64_t>(hasher(key));
+        value      = (value ^ (value >> 31U)) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<std::size_t>((value >> 32U) % shards.size());
+    }
+
+    /// @brief The shards of the map.
+    std::vector<shard_t> shards;
+    /// @brief The global sequence, used to keep track of the insertion order.
+    std::atomic<std::uint64_t> sequence;
+    /// @brief The hash function.
+    Hash hasher;
+};
+
+} // namespace ordered_map
@@ -0,0 +1,290 @@
+/// @file cow_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A copy-on-write version of the ordered map.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_map/ordered_map.hpp"
+
+#include <atomic>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ordered_map
+{
+
+/// @brief A copy-on-write handle to an `ordered_map_t`.
+/// @details Copying the handle only increases a reference count, so that
+/// several handles can share the same map. The first mutation performed
+/// through a handle which is sharing the map detaches it, by cloning the map.
+/// The reading functions never detach the handle. A single handle must not be
+/// used concurrently from multiple threads, but different handles sharing the
+/// same map can be read and copied from different threads. The handles keep
+/// their own count of owners, released with `release` ordering and checked
+/// with `acquire` ordering, so that a handle modifies the map in place only
+/// after the last reads of the handles destroyed by other threads.
+/// @tparam Key the type of the key.
+/// @tparam Value the value stored inside the map.
+template <typename Key, typename Value>
+class cow_ordered_map_t
+{
+public:
+    /// @brief The type of the shared map.
+    using map_t           = ordered_map_t<Key, Value>;
+    /// @brief This stores the key->value association.
+    using list_entry_t    = typename map_t::list_entry_t;
+    /// @brief Constant iterator for the map, for the user.
+    using const_iterator  = typename map_t::const_iterator;
+    /// @brief The type of a compatible sort function.
+    using sort_function_t = typename map_t::sort_function_t;
+
+    /// @brief Construct a new, empty, map.
+    cow_ordered_map_t()
+        : data(std::make_shared<map_t>())
+        , owners(std::make_shared<std::atomic<long>>(1))
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Construct a handle which shares a copy of the given map.
+    /// @param map the map to copy.
+    explicit cow_ordered_map_t(const map_t &map)
+        : data(std::make_shared<map_t>(map))
+        , owners(std::make_shared<std::atomic<long>>(1))
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Construct a handle which takes ownership of the given map.
+    /// @param map the map to move.
+    explicit cow_ordered_map_t(map_t &&map)
+        : data(std::make_shared<map_t>(std::move(map)))
+        , owners(std::make_shared<std::atomic<long>>(1))
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Copy constructor, which shares the map.
+    /// @param other the handle to copy.
+    cow_ordered_map_t(const cow_ordered_map_t &other)
+        : data(other.data)
+        , owners(other.owners)
+    {
+        owners->fetch_add(1, std::memory_order_relaxed);
+    }
+
+    /// @brief Move constructor, the other handle is left without a map.
+    /// @param other the handle to move.
+    cow_ordered_map_t(cow_ordered_map_t &&other) noexcept
+        : data(std::move(other.data))
+        , owners(std::move(other.owners))
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Releases the map.
+    ~cow_ordered_map_t() { this->release(); }
+
+    /// @brief Copy assignment, which shares the map.
+    /// @param other the handle to copy.
+    /// @return a reference to this handle.
+    auto operator=(const cow_ordered_map_t &other) -> cow_ordered_map_t &
+    {
+        cow_ordered_map_t copy(other);
+        this->swap(copy);
+        return *this;
+    }
+
+    /// @brief Move assignment, the other handle is left without a map.
+    /// @param other the handle to move.
+    /// @return a reference to this handle.
+    auto operator=(cow_ordered_map_t &&other) noexcept -> cow_ordered_map_t &
+    {
+        cow_ordered_map_t moved(std::move(other));
+        this->swap(moved);
+        return *this;
+    }
+
+    /// @brief Swaps the maps of two handles.
+    /// @param other the other handle.
+    void swap(cow_ordered_map_t &other) noexcept
+    {
+        data.swap(other.data);
+        owners.swap(other.owners);
+    }
+
+    /// @brief Returns the number of handles sharing the map.
+    /// @return the number of handles.
+    auto use_count() const -> long { return owners ? owners->load(std::memory_order_acquire) : 0; }
+
+    /// @brief Checks if the map is shared with other handles.
+    /// @return true if the map is shared, false otherwise.
+    auto is_shared() const -> bool { return this->use_count() > 1; }
+
+    /// @brief Provides read-only access to the shared map.
+    /// @return a constant reference to the map.
+    auto get() const -> const map_t & { return *data; }
+
+    /// @brief Provides read-write access to the map, detaching it if needed.
+    /// @return a reference to the map, owned only by this handle.
+    /// @details The map is owned only by this handle until the handle is
+    /// copied, either directly or by `save_async`. Any copy invalidates the
+    /// reference: writing through it afterwards would modify the map seen by
+    /// the other handles too, so `mutate` must be called again instead.
+    auto mutate() -> map_t &
+    {
+        this->detach();
+        return *data;
+    }
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t { return data->size(); }
+
+    /// @brief Returns a const iterator the beginning of the map.
+    /// @return an iterator to the beginning of the map.
+    auto begin() const -> const_iterator { return data->begin(); }
+
+    /// @brief Returns a const iterator the end of the map.
+    /// @return an iterator to the end of the map.
+    auto end() const -> const_iterator { return data->end(); }
+
+    /// @brief Returns an iterator to the element associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or the end of the map if not found.
+    auto find(const Key &key) const -> const_iterator { return data->find(key); }
+
+    /// @brief Returns an iterator to the element in the given position.
+    /// @param position the position of the element to retrieve.
+    /// @return an iterator to the element, or the end of the map if not found.
+    auto at(std::size_t position) const -> const_iterator { return data->at(position); }
+
+    /// @brief Sets/updates the `<key,value>` pair inside the map.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    void set(const Key &key, const Value &value) { this->mutate().set(key, value); }
+
+    /// @brief Erases the element associated with the given key.
+    /// @param key the key of the element to remove.
+    /// @return true if the element was removed, false otherwise.
+    auto erase(const Key &key) -> bool
+    {
+        // Avoid detaching when there is nothing to remove.
+        if (data->find(key) == data->end()) {
+            return false;
+        }
+        this->mutate().erase(key);
+        return true;
+    }
+
+    /// @brief Erases all the elements that satisfy the given predicate.
+    /// @param pred the predicate, called once on each `list_entry_t`.
+    /// @return the number of erased elements.
+    template <typename Predicate>
+    auto erase_if(Predicate pred) -> std::size_t
+    {
+        return this->mutate().erase_if(pred);
+    }
+
+    /// @brief Sorts the map.
+    /// @param fun the sorting function.
+    void sort(const sort_function_t &fun) { this->mutate().sort(fun); }
+
+    /// @brief Clears the content of the map.
+    /// @details A shared map is not cloned, the handle simply starts using a
+    /// new empty map.
+    void clear()
+    {
+        if (this->is_shared()) {
+            this->release();
+            data   = std::make_shared<map_t>();
+            owners = std::make_shared<std::atomic<long>>(1);
+        } else {
+            data->clear();
+        }
+    }
+
+    /// @brief Saves the current content of the map to a file, from a background thread.
+    /// @param path the path of the file, written with `ordered_map_t::save`.
+    /// @return a future which becomes ready when the file is written, or
+    /// holds the exception which interrupted the save.
+    /// @details The thread saves its own handle to the map, so the map is
+    /// frozen at the moment of the call. This handle keeps modifying the map
+    /// meanwhile: its first modification detaches it from the frozen map, at
+    /// the cost of a copy in memory, which is much cheaper than serializing
+    /// the map. Unlike `std::async`, discarding the future does not wait for
+    /// the save to complete. The thread releases its handle as soon as it
+    /// stops reading, before the future becomes ready.
+    auto save_async(const std::string &path) const -> std::future<void>
+    {
+        std::shared_ptr<std::promise<void>> promise = std::make_shared<std::promise<void>>();
+        std::future<void> future                    = promise->get_future();
+        cow_ordered_map_t frozen(*this);
+        std::thread([frozen, path, promise]() mutable {
+            std::exception_ptr error;
+            try {
+                std::vector<char> buffer(1U << 20U);
+                std::ofstream stream;
+                stream.rdbuf()->pubsetbuf(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+                stream.open(path, std::ios::binary | std::ios::trunc);
+                if (!stream) {
+                    throw std::runtime_error("cow_ordered_map_t: cannot open " + path);
+                }
+                frozen.get().save(stream);
+                stream.close();
+                if (!stream) {
+                    throw std::runtime_error("cow_ordered_map_t: cannot write " + path);
+                }
+            } catch (...) {
+                error = std::current_exception();
+            }
+            frozen.release();
+            if (error) {
+                promise->set_exception(error);
+            } else {
+                promise->set_value();
+            }
+        }).detach();
+        return future;
+    }
+
+private:
+    /// @brief Gives up the map, leaving the handle without one.
+    void release()
+    {
+        if (owners) {
+            // Pairs with the acquire in `use_count`, the map is not read anymore.
+            owners->fetch_sub(1, std::memory_order_release);
+            owners.reset();
+        }
+        data.reset();
+    }
+
+    /// @brief Clones the map, if it is shared with other handles.
+    void detach()
+    {
+        if (this->is_shared()) {
+            std::shared_ptr<map_t> clone = std::make_shared<map_t>(*data);
+            this->release();
+            data   = std::move(clone);
+            owners = std::make_shared<std::atomic<long>>(1);
+        }
+    }
+
+    /// @brief The shared map.
+    std::shared_ptr<map_t> data;
+    /// @brief The number of handles sharing the map.
+    std::shared_ptr<std::atomic<long>> owners;
+};
+
+} // namespace ordered_map
@@ -0,0 +1,110 @@
+/// @file executor.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief The executors used by the parallel algorithms of the ordered map.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+/// @details An executor is any object providing:
+///  - `concurrency()`, which returns the number of tasks that can run at once;
+///  - `parallel_for(count, fun)`, which calls `fun(i)` for each `i` in the
+///    range `[0, count)`, possibly concurrently, and returns once all the
+///    calls are completed, re-throwing the first exception thrown by them.
+///
+/// Besides the executors defined here, `work_stealing_pool.hpp` provides a
+/// pool of persistent workers, which balance the load by stealing tasks.
+///
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ordered_map
+{
+
+/// @brief An executor which runs everything on the calling thread.
+class sequential_executor_t
+{
+public:
+    /// @brief Returns the number of tasks that can run at once.
+    /// @return always one.
+    static auto concurrency() -> std::size_t { return 1; }
+
+    /// @brief Calls the function on each index, in order.
+    /// @param count the number of indices.
+    /// @param fun the function, called as `fun(std::size_t)`.
+    template <typename Function>
+    void parallel_for(std::size_t count, Function fun) const
+    {
+        for (std::size_t index = 0; index < count; ++index) {
+            fun(index);
+        }
+    }
+};
+
+/// @brief An executor which spawns a set of `std::thread` for each call.
+class thread_executor_t
+{
+public:
+    /// @brief Construct a new executor.
+    /// @param _threads the number of threads, zero to use all the hardware threads.
+    explicit thread_executor_t(std::size_t _threads = 0)
+        : threads(_threads)
+    {
+        if (threads == 0) {
+            threads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+        }
+    }
+
+    /// @brief Returns the number of tasks that can run at once.
+    /// @return the number of threads.
+    auto concurrency() const -> std::size_t { return threads; }
+
+    /// @brief Calls the function on each index, using all the threads.
+    /// @param count the number of indices.
+    /// @param fun the function, called as `fun(std::size_t)`.
+    template <typename Function>
+    void parallel_for(std::size_t count, Function fun) const
+    {
+        std::atomic<std::size_t> next(0);
+        std::exception_ptr error;
+        std::mutex error_mutex;
+        // Each thread takes the next index, until they are over.
+        auto worker = [&next, &error, &error_mutex, &fun, count]() {
+            for (std::size_t index = next++; index < count; index = next++) {
+                try {
+                    fun(index);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        std::size_t spawned = std::min(threads, count);
+        for (std::size_t thread = 1; thread < spawned; ++thread) {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (std::thread &thread : pool) {
+            thread.join();
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    /// @brief The number of threads.
+    std::size_t threads;
+};
+
+} // namespace ordered_map
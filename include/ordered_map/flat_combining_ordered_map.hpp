@@ -0,0 +1,278 @@
+/// @file flat_combining_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A flat-combining wrapper around the ordered map.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_map/ordered_map.hpp"
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace ordered_map
+{
+
+/// @brief An ordered map shared by many threads, using flat combining.
+/// @details Each thread publishes its operation inside its own record. The
+/// thread which acquires the lock becomes the combiner, and executes all the
+/// pending operations in one go, while the others wait for their record to
+/// be served. This way, the lock changes hands once per batch, rather than
+/// once per operation, and the map stays in the cache of the combiner. The
+/// size of each batch is recorded inside a histogram, where the i-th bucket
+/// counts the batches with a size in the range `(2^(i-1), 2^i]`.
+/// @tparam Key the type of the key.
+/// @tparam Value the value stored inside the map.
+template <typename Key, typename Value>
+class flat_combining_ordered_map_t
+{
+public:
+    /// @brief The type of the wrapped map.
+    using map_t = ordered_map_t<Key, Value>;
+
+    /// @brief A registered thread, it must be used by one thread at a time.
+    class handle_t
+    {
+    public:
+        /// @brief Move constructor.
+        /// @param other the handle to move.
+        handle_t(handle_t &&other) noexcept
+            : owner(other.owner)
+            , index(other.index)
+        {
+            other.owner = nullptr;
+        }
+
+        /// @brief Releases the record of the handle.
+        ~handle_t()
+        {
+            if (owner != nullptr) {
+                owner->records[index].used.store(false, std::memory_order_release);
+            }
+        }
+
+        /// @brief Executes the given operation on the map.
+        /// @param fun the operation, called as `fun(map_t &)` while holding
+        /// the lock, possibly by another thread. Results can be returned by
+        /// capturing local variables by reference.
+        template <typename Function>
+        void execute(Function fun) const
+        {
+            owner->execute(owner->records[index], fun);
+        }
+
+        /// @brief Sets/updates the `<key,value>` pair inside the map.
+        /// @param key the value identifier.
+        /// @param value the actual value.
+        /// @return true if the key was inserted, false if it was updated.
+        auto set(const Key &key, const Value &value) const -> bool
+        {
+            bool inserted = false;
+            this->execute([&key, &value, &inserted](map_t &map) {
+                std::size_t previous = map.size();
+                map.set(key, value);
+                inserted = map.size() != previous;
+            });
+            return inserted;
+        }
+
+        /// @brief Copies the value associated with the given key.
+        /// @param key the key of the element to search for.
+        /// @param value where the value is copied, if found.
+        /// @return true if the key was found, false otherwise.
+        auto find(const Key &key, Value &value) const -> bool
+        {
+            bool found = false;
+            this->execute([&key, &value, &found](map_t &map) {
+                typename map_t::iterator it = map.find(key);
+                found                       = it != map.end();
+                if (found) {
+                    value = it->second;
+                }
+            });
+            return found;
+        }
+
+        /// @brief Erases the element associated with the given key.
+        /// @param key the key of the element to remove.
+        /// @return true if the element was removed, false otherwise.
+        auto erase(const Key &key) const -> bool
+        {
+            bool erased = false;
+            this->execute([&key, &erased](map_t &map) {
+                std::size_t previous = map.size();
+                map.erase(key);
+                erased = map.size() != previous;
+            });
+            return erased;
+        }
+
+        handle_t(const handle_t &)                     = delete;
+        auto operator=(const handle_t &) -> handle_t & = delete;
+        auto operator=(handle_t &&) -> handle_t &      = delete;
+
+    private:
+        friend class flat_combining_ordered_map_t;
+
+        /// @brief Creates the handle.
+        handle_t(flat_combining_ordered_map_t *_owner, std::size_t _index)
+            : owner(_owner)
+            , index(_index)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief The shared map.
+        flat_combining_ordered_map_t *owner;
+        /// @brief The index of the record owned by the handle.
+        std::size_t index;
+    };
+
+    /// @brief Construct a new, empty, map.
+    /// @param max_threads the maximum number of handles registered at once.
+    explicit flat_combining_ordered_map_t(std::size_t max_threads = 128)
+        : map()
+        , lock()
+        , records(max_threads)
+        , histogram()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Registers a new thread.
+    /// @return the handle of the thread.
+    /// @throws std::runtime_error if all the records are in use.
+    auto make_handle() -> handle_t
+    {
+        for (std::size_t index = 0; index < records.size(); ++index) {
+            bool expected = false;
+            if (records[index].used.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                return handle_t(this, index);
+            }
+        }
+        throw std::runtime_error("flat_combining_ordered_map_t: too many threads");
+    }
+
+    /// @brief Returns the histogram of the sizes of the combined batches.
+    /// @return the histogram, the i-th bucket counts the batches with a size
+    /// in the range `(2^(i-1), 2^i]`.
+    auto batch_histogram() const -> std::vector<std::size_t>
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        return histogram;
+    }
+
+    /// @brief Provides access to the map, when no other thread is using it.
+    /// @return a reference to the map.
+    auto unsafe_map() -> map_t & { return map; }
+
+private:
+    /// @brief The record of a thread, kept on its own cache line.
+    struct record_t {
+        /// @brief Construct a new free record.
+        record_t()
+            : used(false)
+            , pending(false)
+            , context(nullptr)
+            , invoke(nullptr)
+            , error()
+            , padding()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief If the record is owned by a handle.
+        std::atomic<bool> used;
+        /// @brief If the record contains an operation waiting to be executed.
+        std::atomic<bool> pending;
+        /// @brief The operation, which lives on the stack of the waiting thread.
+        void *context;
+        /// @brief Calls the operation.
+        void (*invoke)(void *, map_t &);
+        /// @brief The exception thrown by the operation, if any.
+        std::exception_ptr error;
+        /// @brief Keeps adjacent records on different cache lines.
+        char padding[64];
+    };
+
+    /// @brief Calls the operation stored inside a record.
+    template <typename Function>
+    static void invoke_function(void *context, map_t &target)
+    {
+        (*static_cast<Function *>(context))(target);
+    }
+
+    /// @brief Publishes the operation, and waits for it to be executed.
+    template <typename Function>
+    void execute(record_t &record, Function &fun)
+    {
+        record.context = &fun;
+        record.invoke  = &flat_combining_ordered_map_t::invoke_function<Function>;
+        record.error   = nullptr;
+        record.pending.store(true, std::memory_order_release);
+        for (unsigned attempt = 0; record.pending.load(std::memory_order_acquire); ++attempt) {
+            if (lock.try_lock()) {
+                this->combine();
+                lock.unlock();
+            } else if (attempt > 64) {
+                std::this_thread::yield();
+            }
+        }
+        if (record.error) {
+            std::rethrow_exception(record.error);
+        }
+    }
+
+    /// @brief Executes all the pending operations, the lock must be held.
+    void combine()
+    {
+        std::size_t batch = 0;
+        // A few passes catch the operations published while combining.
+        for (unsigned pass = 0; pass < 3; ++pass) {
+            std::size_t served = 0;
+            for (record_t &record : records) {
+                if (record.pending.load(std::memory_order_acquire)) {
+                    try {
+                        record.invoke(record.context, map);
+                    } catch (...) {
+                        record.error = std::current_exception();
+                    }
+                    record.pending.store(false, std::memory_order_release);
+                    ++served;
+                }
+            }
+            if (served == 0) {
+                break;
+            }
+            batch += served;
+        }
+        if (batch > 0) {
+            std::size_t bucket = 0;
+            while ((static_cast<std::size_t>(1) << bucket) < batch) {
+                ++bucket;
+            }
+            if (histogram.size() <= bucket) {
+                histogram.resize(bucket + 1, 0);
+            }
+            ++histogram[bucket];
+        }
+    }
+
+    /// @brief The wrapped map.
+    map_t map;
+    /// @brief The lock held by the combiner.
+    mutable std::mutex lock;
+    /// @brief The records of the threads.
+    std::vector<record_t> records;
+    /// @brief The histogram of the sizes of the combined batches.
+    std::vector<std::size_t> histogram;
+};
+
+} // namespace ordered_map
@@ -0,0 +1,399 @@
+/// @file front_coded.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A compact binary format for maps with string keys sharing long prefixes.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+/// @details The format starts with a header, followed by the blocks of
+/// entries, an index with the offset of each block, and the offset of the
+/// index. Each block contains up to `restart_interval` entries, in insertion
+/// order. The first key of a block (the restart point) is stored in full,
+/// while the following ones store only the length of the prefix shared with
+/// the previous key, and the remaining suffix. Values are stored by their
+/// `codec_t`. Blocks can be compressed with `lz_compress`, and are stored
+/// uncompressed when that does not reduce their size.
+///
+
+#pragma once
+
+#include "ordered_map/codec.hpp"
+#include "ordered_map/lz.hpp"
+#include "ordered_map/ordered_map.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ordered_map
+{
+
+/// @brief The options of the front-coded format.
+struct front_coded_options_t {
+    /// @brief Construct the default options.
+    front_coded_options_t()
+        : restart_interval(16)
+        , compress(false)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief The number of entries of each block. Accessing an entry decodes
+    /// at most this number of entries, while larger blocks share more prefixes.
+    std::uint32_t restart_interval;
+    /// @brief If the blocks are compressed with `lz_compress`.
+    bool compress;
+};
+
+namespace detail
+{
+
+/// @brief The header of the front-coded format.
+struct front_coded_header_t {
+    /// @brief The magic number, `OMFC`.
+    char magic[4];
+    /// @brief The version of the format.
+    std::uint32_t version;
+    /// @brief The value `0x01020304`, as written by the machine.
+    std::uint32_t byte_order;
+    /// @brief The size of the raw values, or zero.
+    std::uint32_t value_size;
+    /// @brief The number of entries of each block.
+    std::uint32_t restart_interval;
+    /// @brief Keeps the count aligned.
+    std::uint32_t reserved;
+    /// @brief The number of entries.
+    std::uint64_t count;
+};
+
+/// @brief Builds the header of the front-coded format.
+/// @param count the number of entries.
+/// @param restart_interval the number of entries of each block.
+/// @return the header.
+template <typename Value>
+auto make_front_coded_header(std::uint64_t count, std::uint32_t restart_interval) -> front_coded_header_t
+{
+    front_coded_header_t header;
+    std::memcpy(header.magic, "OMFC", sizeof(header.magic));
+    header.version          = 1;
+    header.byte_order       = 0x01020304;
+    header.value_size       = is_raw_codec<Value>::value ? static_cast<std::uint32_t>(sizeof(Value)) : 0;
+    header.restart_interval = restart_interval;
+    header.reserved         = 0;
+    header.count            = count;
+    return header;
+}
+
+/// @brief Reads and validates the header of the front-coded format.
+/// @param stream the input stream.
+/// @return the header.
+/// @throws std::runtime_error if the header is not valid.
+template <typename Value>
+auto read_front_coded_header(std::istream &stream) -> front_coded_header_t
+{
+    front_coded_header_t header;
+    read_bytes(stream, &header, sizeof(header));
+    const front_coded_header_t expected = make_front_coded_header<Value>(header.count, header.restart_interval);
+    if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0) {
+        throw std::runtime_error("front_coded: the stream does not contain a map");
+    }
+    if ((header.version != expected.version) || (header.byte_order != expected.byte_order)) {
+        throw std::runtime_error("front_coded: unsupported format version or byte order");
+    }
+    if (header.value_size != expected.value_size) {
+        throw std::runtime_error("front_coded: the stream contains different types");
+    }
+    if (header.restart_interval == 0) {
+        throw std::runtime_error("front_coded: invalid restart interval");
+    }
+    return header;
+}
+
+/// @brief Returns the number of blocks of the format.
+inline auto front_coded_blocks(const front_coded_header_t &header) -> std::uint64_t
+{
+    return (header.count + header.restart_interval - 1) / header.restart_interval;
+}
+
+/// @brief Writes a variable-length integer to the stream.
+inline void write_number(std::ostream &stream, std::uint64_t value)
+{
+    std::string bytes;
+    lz_append_number(bytes, value);
+    write_bytes(stream, bytes.data(), bytes.size());
+}
+
+/// @brief Reads a variable-length integer from the stream.
+/// @throws std::runtime_error if the stream ends before, or the integer is too long.
+inline auto read_number(std::istream &stream) -> std::uint64_t
+{
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        unsigned char byte = 0;
+        read_bytes(stream, &byte, 1);
+        value |= static_cast<std::uint64_t>(byte & 0x7FU) << shift;
+        if ((byte & 0x80U) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("front_coded: invalid integer");
+}
+
+/// @brief Writes a block, compressing it if that reduces its size.
+/// @param stream the output stream.
+/// @param block the encoded entries.
+/// @param compress if the block should be compressed.
+/// @return the number of bytes written.
+inline auto write_front_coded_block(std::ostream &stream, const std::string &block, bool compress) -> std::uint64_t
+{
+    if (block.size() > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::length_error("front_coded: the block is too large, reduce the restart interval");
+    }
+    std::uint8_t method = 0;
+    std::string packed;
+    if (compress) {
+        packed = lz_compress(block);
+        method = packed.size() < block.size() ? 1 : 0;
+    }
+    const std::string &stored = (method == 1) ? packed : block;
+    codec_t<std::uint8_t>::encode(stream, method);
+    codec_t<std::uint32_t>::encode(stream, static_cast<std::uint32_t>(block.size()));
+    codec_t<std::uint32_t>::encode(stream, static_cast<std::uint32_t>(stored.size()));
+    write_bytes(stream, stored.data(), stored.size());
+    return 9 + stored.size();
+}
+
+/// @brief Reads a block, decompressing it if needed.
+/// @param stream the input stream.
+/// @param block where the encoded entries are stored.
+inline void read_front_coded_block(std::istream &stream, std::string &block)
+{
+    std::uint8_t method = 0;
+    std::uint32_t size  = 0;
+    std::uint32_t bytes = 0;
+    codec_t<std::uint8_t>::decode(stream, method);
+    codec_t<std::uint32_t>::decode(stream, size);
+    codec_t<std::uint32_t>::decode(stream, bytes);
+    if ((method > 1) || ((method == 0) && (size != bytes))) {
+        throw std::runtime_error("front_coded: invalid block");
+    }
+    block.resize(bytes);
+    read_bytes(stream, &block[0], bytes);
+    if (method == 1) {
+        block = lz_decompress(block, size);
+    }
+}
+
+/// @brief Decodes the entries of a block.
+/// @param block the encoded entries.
+/// @param count the number of entries.
+/// @param entries where the entries are appended.
+template <typename Value>
+void decode_front_coded_block(const std::string &block, std::size_t count,
+                              std::vector<std::pair<std::string, Value>> &entries)
+{
+    std::istringstream stream(block);
+    std::string key;
+    for (std::size_t index = 0; index < count; ++index) {
+        const std::uint64_t shared = read_number(stream);
+        const std::uint64_t suffix = read_number(stream);
+        if ((shared > key.size()) || ((index == 0) && (shared != 0)) || (suffix > block.size())) {
+            throw std::runtime_error("front_coded: invalid key");
+        }
+        key.resize(static_cast<std::size_t>(shared + suffix));
+        read_bytes(stream, &key[static_cast<std::size_t>(shared)], static_cast<std::size_t>(suffix));
+        entries.emplace_back(key, Value());
+        codec_t<Value>::decode(stream, entries.back().second);
+    }
+}
+
+} // namespace detail
+
+/// @brief Writes the map to a stream, using the front-coded format.
+/// @param map the map.
+/// @param stream the output stream, which should be opened in binary mode.
+/// @param options the options of the format.
+/// @throws std::runtime_error if the stream fails.
+template <typename Value>
+void save_front_coded(const ordered_map_t<std::string, Value> &map,
+                      std::ostream &stream,
+                      const front_coded_options_t &options = front_coded_options_t())
+{
+    if (options.restart_interval == 0) {
+        throw std::invalid_argument("front_coded: the restart interval must be positive");
+    }
+    const detail::front_coded_header_t header =
+        detail::make_front_coded_header<Value>(map.size(), options.restart_interval);
+    detail::write_bytes(stream, &header, sizeof(header));
+    std::uint64_t written = sizeof(header);
+    std::vector<std::uint64_t> offsets;
+    std::ostringstream block;
+    const std::string *previous = nullptr;
+    std::uint32_t used          = 0;
+    for (typename ordered_map_t<std::string, Value>::const_iterator it = map.begin(); it != map.end(); ++it) {
+        const std::string &key = it->first;
+        std::size_t shared     = 0;
+        if (previous != nullptr) {
+            const std::size_t limit = std::min(previous->size(), key.size());
+            while ((shared < limit) && ((*previous)[shared] == key[shared])) {
+                ++shared;
+            }
+        }
+        detail::write_number(block, shared);
+        detail::write_number(block, key.size() - shared);
+        detail::write_bytes(block, key.data() + shared, key.size() - shared);
+        codec_t<Value>::encode(block, it->second);
+        previous = &key;
+        if (++used == options.restart_interval) {
+            offsets.push_back(written);
+            written += detail::write_front_coded_block(stream, block.str(), options.compress);
+            block.str(std::string());
+            previous = nullptr;
+            used     = 0;
+        }
+    }
+    if (used > 0) {
+        offsets.push_back(written);
+        written += detail::write_front_coded_block(stream, block.str(), options.compress);
+    }
+    for (std::uint64_t offset : offsets) {
+        codec_t<std::uint64_t>::encode(stream, offset);
+    }
+    codec_t<std::uint64_t>::encode(stream, written);
+}
+
+/// @brief Replaces the content of the map with the one read from a stream,
+/// written by `save_front_coded`.
+/// @param stream the input stream.
+/// @param map the map, left untouched if the stream is not valid.
+/// @throws std::runtime_error if the stream is truncated, contains
+/// duplicated keys, or was written with an incompatible format.
+template <typename Value>
+void load_front_coded(std::istream &stream, ordered_map_t<std::string, Value> &map)
+{
+    const detail::front_coded_header_t header = detail::read_front_coded_header<Value>(stream);
+    const std::uint64_t blocks                = detail::front_coded_blocks(header);
+    // A corrupted count must not exhaust the memory before failing.
+    std::vector<std::pair<std::string, Value>> entries;
+    entries.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(header.count, 1U << 20U)));
+    std::string block;
+    for (std::uint64_t index = 0; index < blocks; ++index) {
+        detail::read_front_coded_block(stream, block);
+        const std::uint64_t count = std::min<std::uint64_t>(header.restart_interval, header.count - entries.size());
+        detail::decode_front_coded_block(block, static_cast<std::size_t>(count), entries);
+    }
+    // Skip the index and its offset.
+    for (std::uint64_t index = 0; index <= blocks; ++index) {
+        std::uint64_t offset = 0;
+        codec_t<std::uint64_t>::decode(stream, offset);
+    }
+    ordered_map_t<std::string, Value> result;
+    result.append(std::make_move_iterator(entries.begin()), std::make_move_iterator(entries.end()));
+    if (result.size() != entries.size()) {
+        throw std::runtime_error("front_coded: the stream contains duplicated keys");
+    }
+    map = std::move(result);
+}
+
+/// @brief Provides access by position to the entries of a stream written by
+/// `save_front_coded`, without loading the whole map.
+/// @details Accessing an entry reads and decodes only its block, and the
+/// last decoded block is kept, so that accessing nearby entries is cheap.
+/// @tparam Value the value stored inside the map.
+template <typename Value>
+class front_coded_reader_t
+{
+public:
+    /// @brief Opens the format, reading its header and its index.
+    /// @param _stream the input stream, which must be seekable, and must end with the format.
+    /// @throws std::runtime_error if the stream is not valid.
+    explicit front_coded_reader_t(std::istream &_stream)
+        : stream(_stream)
+        , base(_stream.tellg())
+        , header(detail::read_front_coded_header<Value>(_stream))
+        , offsets()
+        , cached(std::numeric_limits<std::uint64_t>::max())
+        , entries()
+    {
+        const std::uint64_t blocks = detail::front_coded_blocks(header);
+        stream.seekg(0, std::ios::end);
+        const auto size = static_cast<std::uint64_t>(stream.tellg() - base);
+        if ((blocks >= size / sizeof(std::uint64_t)) ||
+            (size < sizeof(header) + ((blocks + 1) * sizeof(std::uint64_t)))) {
+            throw std::runtime_error("front_coded: the stream is truncated");
+        }
+        const std::uint64_t index = size - ((blocks + 1) * sizeof(std::uint64_t));
+        stream.seekg(base + static_cast<std::streamoff>(index));
+        offsets.resize(static_cast<std::size_t>(blocks));
+        for (std::uint64_t &offset : offsets) {
+            codec_t<std::uint64_t>::decode(stream, offset);
+            if ((offset < sizeof(header)) || (offset >= index)) {
+                throw std::runtime_error("front_coded: invalid index");
+            }
+        }
+        std::uint64_t written = 0;
+        codec_t<std::uint64_t>::decode(stream, written);
+        if (written != index) {
+            throw std::runtime_error("front_coded: invalid index");
+        }
+    }
+
+    /// @brief Returns the number of entries.
+    /// @return the number of entries.
+    auto size() const -> std::size_t { return static_cast<std::size_t>(header.count); }
+
+    /// @brief Reads the entry in the given position, in insertion order.
+    /// @param position the position of the entry.
+    /// @param key where the key is copied.
+    /// @param value where the value is copied.
+    /// @return true if the entry exists, false otherwise.
+    /// @throws std::runtime_error if the block of the entry is not valid.
+    auto at(std::size_t position, std::string &key, Value &value) -> bool
+    {
+        if (position >= header.count) {
+            return false;
+        }
+        const std::uint64_t block = position / header.restart_interval;
+        if (block != cached) {
+            std::string bytes;
+            stream.clear();
+            stream.seekg(base + static_cast<std::streamoff>(offsets[static_cast<std::size_t>(block)]));
+            detail::read_front_coded_block(stream, bytes);
+            const std::uint64_t first = block * header.restart_interval;
+            entries.clear();
+            cached = std::numeric_limits<std::uint64_t>::max();
+            detail::decode_front_coded_block(
+                bytes, static_cast<std::size_t>(std::min<std::uint64_t>(header.restart_interval, header.count - first)),
+                entries);
+            cached = block;
+        }
+        const std::pair<std::string, Value> &entry = entries[position % header.restart_interval];
+        key                                        = entry.first;
+        value                                      = entry.second;
+        return true;
+    }
+
+private:
+    /// @brief The input stream.
+    std::istream &stream;
+    /// @brief The position of the format inside the stream.
+    std::streampos base;
+    /// @brief The header.
+    detail::front_coded_header_t header;
+    /// @brief The offset of each block.
+    std::vector<std::uint64_t> offsets;
+    /// @brief The decoded block, or the maximum value.
+    std::uint64_t cached;
+    /// @brief The entries of the decoded block.
+    std::vector<std::pair<std::string, Value>> entries;
+};
+
+} // namespace ordered_map
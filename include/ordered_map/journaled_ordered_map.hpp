@@ -0,0 +1,650 @@
+/// @file journaled_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A durable ordered map, backed by a write-ahead journal.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+/// @details This header requires a POSIX system (`fsync`, `rename`).
+///
+
+#pragma once
+
+#include "ordered_map/ordered_map.hpp"
+
+#include <cerrno>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ordered_map
+{
+
+/// @brief When the journal is written and synchronized with the disk.
+enum class sync_policy_t {
+    /// @brief Records are written when `flush` is called, or when enough of them are pending.
+    buffered,
+    /// @brief Records are written before each operation returns, without waiting for the disk.
+    write,
+    /// @brief Records are written and synchronized with the disk before each operation returns.
+    sync,
+};
+
+namespace detail
+{
+
+/// @brief Throws the error stored inside `errno`.
+/// @param what the description of the failed operation.
+[[noreturn]] inline void throw_errno(const std::string &what)
+{
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+/// @brief Writes the whole buffer to the descriptor.
+/// @param descriptor the file descriptor.
+/// @param data the buffer.
+/// @param size the size of the buffer.
+inline void write_descriptor(int descriptor, const char *data, std::size_t size)
+{
+    while (size > 0) {
+        ssize_t written = ::write(descriptor, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            detail::throw_errno("journal: write failed");
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+}
+
+/// @brief Waits until the content of the descriptor reaches the disk.
+/// @param descriptor the file descriptor.
+inline void sync_descriptor(int descriptor)
+{
+#if defined(__APPLE__)
+    const int result = ::fsync(descriptor);
+#else
+    const int result = ::fdatasync(descriptor);
+#endif
+    if (result != 0) {
+        detail::throw_errno("journal: sync failed");
+    }
+}
+
+/// @brief Computes the 32-bit FNV-1a checksum of the given bytes.
+/// @param data the bytes.
+/// @param size the number of bytes.
+/// @return the checksum.
+inline auto journal_checksum(const char *data, std::size_t size) -> std::uint32_t
+{
+    std::uint32_t hash = 2166136261U;
+    for (std::size_t index = 0; index < size; ++index) {
+        hash = (hash ^ static_cast<unsigned char>(data[index])) * 16777619U;
+    }
+    return hash;
+}
+
+} // namespace detail
+
+/// @brief An ordered map which survives crashes, by appending each
+/// modification to a journal before returning.
+/// @details The state is stored inside three files, next to the given path:
+///  - `<path>.snapshot`, the whole map, with the sequence number of the last
+///    operation it contains;
+///  - `<path>.log`, the operations performed after the snapshot;
+///  - `<path>.log.old`, the previous log, while a compaction is running.
+///
+/// Each record of the log contains its length, a checksum, the sequence
+/// number and the operation, with keys and values encoded by `codec_t`.
+/// When the map is opened, the snapshot is loaded and the logs are replayed,
+/// stopping at the first incomplete or corrupted record (left by a crash
+/// while writing), which is then truncated. If writing or synchronizing the
+/// log fails, the journal is failed: the records might be lost, so all the
+/// following writes are refused, by throwing the original error.
+///
+/// Concurrent operations are committed in groups: the first thread which
+/// needs its records on disk writes (and synchronizes) all the pending ones,
+/// while the others wait for it. When the log grows beyond a threshold, a
+/// background thread writes a new snapshot, and discards the old log.
+/// @tparam Key the type of the key.
+/// @tparam Value the value stored inside the map.
+template <typename Key, typename Value>
+class journaled_ordered_map_t
+{
+public:
+    /// @brief The type of the wrapped map.
+    using map_t = ordered_map_t<Key, Value>;
+
+    /// @brief The options of the journal.
+    struct options_t {
+        /// @brief Construct the default options.
+        options_t()
+            : sync(sync_policy_t::sync)
+            , compaction_threshold(64U << 20U)
+            , buffer_limit(1U << 20U)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief When the records are written and synchronized.
+        sync_policy_t sync;
+        /// @brief The size of the log, in bytes, which triggers a compaction.
+        std::uint64_t compaction_threshold;
+        /// @brief The size of the pending records, in bytes, which forces a
+        /// write with the `buffered` policy.
+        std::size_t buffer_limit;
+    };
+
+    /// @brief Opens the map, recovering its state from the files.
+    /// @param _path the base path of the files.
+    /// @param _options the options of the journal.
+    /// @throws std::system_error if the files cannot be accessed.
+    /// @throws std::runtime_error if the snapshot is corrupted, or records are missing from the log.
+    explicit journaled_ordered_map_t(const std::string &_path, options_t _options = options_t())
+        : path(_path)
+        , options(_options)
+        , map()
+        , mutex()
+        , flushed()
+        , pending()
+        , last_lsn(0)
+        , written_lsn(0)
+        , synced_lsn(0)
+        , flushing(false)
+        , write_error()
+        , log_descriptor(-1)
+        , log_bytes(0)
+        , compacting(false)
+        , compactor()
+        , compaction_error()
+    {
+        std::uint64_t snapshot_lsn = this->load_snapshot();
+        last_lsn                   = snapshot_lsn;
+        const bool interrupted     = this->replay(path + ".log.old", snapshot_lsn, false);
+        this->replay(path + ".log", snapshot_lsn, true);
+        written_lsn    = last_lsn;
+        synced_lsn     = last_lsn;
+        log_descriptor = ::open((path + ".log").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (log_descriptor < 0) {
+            detail::throw_errno("journal: cannot open " + path + ".log");
+        }
+        if (interrupted) {
+            // Finish the compaction interrupted by a crash.
+            this->write_snapshot(map, last_lsn);
+            std::remove((path + ".log.old").c_str());
+        }
+    }
+
+    /// @brief Writes the pending records, and closes the journal.
+    ~journaled_ordered_map_t()
+    {
+        try {
+            this->flush();
+        } catch (...) {
+            // Destructors must not throw, call flush() to see the error.
+        }
+        if (compactor.joinable()) {
+            compactor.join();
+        }
+        ::close(log_descriptor);
+    }
+
+    journaled_ordered_map_t(const journaled_ordered_map_t &)                     = delete;
+    journaled_ordered_map_t(journaled_ordered_map_t &&)                          = delete;
+    auto operator=(const journaled_ordered_map_t &) -> journaled_ordered_map_t & = delete;
+    auto operator=(journaled_ordered_map_t &&) -> journaled_ordered_map_t &      = delete;
+
+    /// @brief Sets/updates the `<key,value>` pair inside the map.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    void set(const Key &key, const Value &value)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::ostringstream payload = this->begin_record(op_set);
+        map.set(key, value);
+        codec_t<Key>::encode(payload, key);
+        codec_t<Value>::encode(payload, value);
+        this->commit(lock, this->end_record(payload));
+    }
+
+    /// @brief Erases the element associated with the given key.
+    /// @param key the key of the element to remove.
+    /// @return true if the element was removed, false otherwise.
+    auto erase(const Key &key) -> bool
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        typename map_t::iterator it = map.find(key);
+        if (it == map.end()) {
+            return false;
+        }
+        std::ostringstream payload = this->begin_record(op_erase);
+        map.erase(it);
+        codec_t<Key>::encode(payload, key);
+        this->commit(lock, this->end_record(payload));
+        return true;
+    }
+
+    /// @brief Sorts the map.
+    /// @param fun the comparison function, between two `list_entry_t`.
+    /// @details The resulting order of the keys is stored inside the journal,
+    /// hence the function is not needed to recover the map.
+    template <typename Compare>
+    void sort(Compare fun)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::ostringstream payload = this->begin_record(op_reorder);
+        map.parallel_sort(fun, sequential_executor_t());
+        const auto count           = static_cast<std::uint64_t>(map.size());
+        codec_t<std::uint64_t>::encode(payload, count);
+        for (typename map_t::const_iterator it = map.begin(); it != map.end(); ++it) {
+            codec_t<Key>::encode(payload, it->first);
+        }
+        this->commit(lock, this->end_record(payload));
+    }
+
+    /// @brief Removes all the elements.
+    void clear()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        std::ostringstream payload = this->begin_record(op_clear);
+        map.clear();
+        this->commit(lock, this->end_record(payload));
+    }
+
+    /// @brief Copies the value associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @param value where the value is copied, if found.
+    /// @return true if the key was found, false otherwise.
+    auto find(const Key &key, Value &value) const -> bool
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        typename map_t::const_iterator it = map.find(key);
+        if (it == map.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return map.size();
+    }
+
+    /// @brief Returns a copy of the map.
+    /// @return the copy.
+    auto copy() const -> map_t
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return map;
+    }
+
+    /// @brief Writes and synchronizes all the pending records.
+    void flush()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        this->write_pending(lock, last_lsn, true);
+    }
+
+    /// @brief Writes a new snapshot and discards the log, waiting for the end.
+    /// @throws the error of a failed background compaction, if any.
+    void compact()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (compacting) {
+            flushed.wait(lock);
+        }
+        this->rethrow_compaction_error();
+        compacting = true;
+        lock.unlock();
+        if (compactor.joinable()) {
+            compactor.join();
+        }
+        this->run_compaction();
+        lock.lock();
+        this->rethrow_compaction_error();
+    }
+
+    /// @brief Returns the size of the current log.
+    /// @return the number of bytes written to the log.
+    auto log_size() const -> std::uint64_t
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return log_bytes;
+    }
+
+private:
+    /// @brief The operations stored inside the records.
+    enum : std::uint8_t {
+        op_set     = 1, ///< Sets a key, followed by the key and the value.
+        op_erase   = 2, ///< Erases a key, followed by the key.
+        op_reorder = 3, ///< Reorders the map, followed by the number of keys and the keys.
+        op_clear   = 4, ///< Clears the map.
+    };
+
+    /// @brief Starts a new record, the lock must be held.
+    /// @throws the error which failed the journal, if any, before the map is modified.
+    auto begin_record(std::uint8_t op) -> std::ostringstream
+    {
+        if (write_error) {
+            std::rethrow_exception(write_error);
+        }
+        std::ostringstream payload(std::ios::out | std::ios::binary);
+        const std::uint64_t lsn = last_lsn + 1;
+        codec_t<std::uint64_t>::encode(payload, lsn);
+        codec_t<std::uint8_t>::encode(payload, op);
+        return payload;
+    }
+
+    /// @brief Appends the record to the pending ones, the lock must be held.
+    /// @return the sequence number of the record.
+    auto end_record(const std::ostringstream &payload) -> std::uint64_t
+    {
+        const std::string data        = payload.str();
+        const auto length             = static_cast<std::uint32_t>(data.size());
+        const std::uint32_t checksum  = detail::journal_checksum(data.data(), data.size());
+        pending.append(reinterpret_cast<const char *>(&length), sizeof(length));
+        pending.append(reinterpret_cast<const char *>(&checksum), sizeof(checksum));
+        pending.append(data);
+        return ++last_lsn;
+    }
+
+    /// @brief Makes the record durable, following the policy, the lock must be held.
+    void commit(std::unique_lock<std::mutex> &lock, std::uint64_t lsn)
+    {
+        if ((options.sync != sync_policy_t::buffered) || (pending.size() >= options.buffer_limit)) {
+            this->write_pending(lock, lsn, options.sync == sync_policy_t::sync);
+        }
+        if ((log_bytes >= options.compaction_threshold) && !compacting && !compaction_error) {
+            compacting = true;
+            if (compactor.joinable()) {
+                compactor.join();
+            }
+            compactor = std::thread([this]() { this->run_compaction(); });
+        }
+    }
+
+    /// @brief Writes the pending records until the given one, joining the
+    /// write in progress if there is one, the lock must be held.
+    /// @details When `sync` is set, the log is synchronized until the given
+    /// record even if it was already written, for instance by the `write`
+    /// policy or by the `buffer_limit`.
+    /// @throws the error which failed the journal, if any.
+    void write_pending(std::unique_lock<std::mutex> &lock, std::uint64_t lsn, bool sync)
+    {
+        while ((written_lsn < lsn) || (sync && (synced_lsn < lsn))) {
+            if (write_error) {
+                std::rethrow_exception(write_error);
+            }
+            if (flushing) {
+                flushed.wait(lock);
+                continue;
+            }
+            // Become the leader, and write the whole group.
+            flushing = true;
+            std::string batch;
+            batch.swap(pending);
+            const std::uint64_t group = last_lsn;
+            const int descriptor      = log_descriptor;
+            lock.unlock();
+            try {
+                detail::write_descriptor(descriptor, batch.data(), batch.size());
+                if (sync) {
+                    detail::sync_descriptor(descriptor);
+                }
+            } catch (...) {
+                // Part of the batch might be on disk, so it cannot be written
+                // again: refuse all the following writes instead.
+                lock.lock();
+                write_error = std::current_exception();
+                flushing    = false;
+                flushed.notify_all();
+                throw;
+            }
+            lock.lock();
+            flushing    = false;
+            written_lsn = group;
+            if (sync) {
+                synced_lsn = group;
+            }
+            log_bytes += batch.size();
+            flushed.notify_all();
+        }
+    }
+
+    /// @brief Moves the log aside, writes the snapshot, then drops the old log.
+    void run_compaction()
+    {
+        try {
+            std::unique_lock<std::mutex> lock(mutex);
+            this->write_pending(lock, last_lsn, true);
+            while (flushing) {
+                flushed.wait(lock);
+            }
+            if (std::rename((path + ".log").c_str(), (path + ".log.old").c_str()) != 0) {
+                detail::throw_errno("journal: cannot rotate " + path + ".log");
+            }
+            const int descriptor = ::open((path + ".log").c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+            if (descriptor < 0) {
+                detail::throw_errno("journal: cannot open " + path + ".log");
+            }
+            ::close(log_descriptor);
+            log_descriptor           = descriptor;
+            synced_lsn               = last_lsn;
+            log_bytes                = 0;
+            const map_t copy         = map;
+            const std::uint64_t upto = last_lsn;
+            lock.unlock();
+            // The new records go to the new log, while the snapshot is written.
+            this->write_snapshot(copy, upto);
+            std::remove((path + ".log.old").c_str());
+            lock.lock();
+            compacting = false;
+            flushed.notify_all();
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            compaction_error = std::current_exception();
+            compacting       = false;
+            flushed.notify_all();
+        }
+    }
+
+    /// @brief Rethrows the error of the last compaction, the lock must be held.
+    void rethrow_compaction_error()
+    {
+        if (compaction_error) {
+            std::exception_ptr error = compaction_error;
+            compaction_error         = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+    /// @brief Writes the snapshot into a temporary file, and then replaces the old one.
+    void write_snapshot(const map_t &content, std::uint64_t lsn) const
+    {
+        std::ostringstream stream(std::ios::out | std::ios::binary);
+        detail::write_bytes(stream, "OMJS", 4);
+        codec_t<std::uint64_t>::encode(stream, lsn);
+        content.save(stream);
+        const std::string data      = stream.str();
+        const std::string temporary = path + ".snapshot.tmp";
+        const int descriptor        = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (descriptor < 0) {
+            detail::throw_errno("journal: cannot create " + temporary);
+        }
+        try {
+            detail::write_descriptor(descriptor, data.data(), data.size());
+            detail::sync_descriptor(descriptor);
+        } catch (...) {
+            ::close(descriptor);
+            throw;
+        }
+        ::close(descriptor);
+        if (std::rename(temporary.c_str(), (path + ".snapshot").c_str()) != 0) {
+            detail::throw_errno("journal: cannot replace " + path + ".snapshot");
+        }
+        // Make the rename durable too.
+        const std::string::size_type slash = path.find_last_of('/');
+        const std::string directory        = (slash == std::string::npos) ? "." : path.substr(0, slash + 1);
+        const int directory_descriptor     = ::open(directory.c_str(), O_RDONLY);
+        if (directory_descriptor >= 0) {
+            ::fsync(directory_descriptor);
+            ::close(directory_descriptor);
+        }
+    }
+
+    /// @brief Loads the snapshot, if there is one.
+    /// @return the sequence number of the last operation it contains.
+    auto load_snapshot() -> std::uint64_t
+    {
+        std::ifstream stream((path + ".snapshot").c_str(), std::ios::in | std::ios::binary);
+        if (!stream) {
+            return 0;
+        }
+        char magic[4];
+        std::uint64_t lsn = 0;
+        detail::read_bytes(stream, magic, sizeof(magic));
+        if (std::memcmp(magic, "OMJS", sizeof(magic)) != 0) {
+            throw std::runtime_error("journal: " + path + ".snapshot is not a snapshot");
+        }
+        codec_t<std::uint64_t>::decode(stream, lsn);
+        map.load(stream);
+        return lsn;
+    }
+
+    /// @brief Replays the records of the given log which follow the snapshot.
+    /// @param file the path of the log.
+    /// @param snapshot_lsn the sequence number of the last operation inside the snapshot.
+    /// @param truncate if an incomplete tail should be removed from the file.
+    /// @return true if the log exists.
+    /// @throws std::runtime_error if a record does not follow the previous one.
+    auto replay(const std::string &file, std::uint64_t snapshot_lsn, bool truncate) -> bool
+    {
+        std::ifstream stream(file.c_str(), std::ios::in | std::ios::binary);
+        if (!stream) {
+            return false;
+        }
+        std::ostringstream buffer(std::ios::out | std::ios::binary);
+        buffer << stream.rdbuf();
+        const std::string content = buffer.str();
+        std::size_t offset = 0;
+        while (content.size() - offset >= 8) {
+            std::uint32_t length   = 0;
+            std::uint32_t checksum = 0;
+            std::memcpy(&length, &content[offset], sizeof(length));
+            std::memcpy(&checksum, &content[offset + 4], sizeof(checksum));
+            if ((content.size() - offset - 8 < length) ||
+                (detail::journal_checksum(&content[offset + 8], length) != checksum)) {
+                break;
+            }
+            std::istringstream payload(content.substr(offset + 8, length), std::ios::in | std::ios::binary);
+            std::uint64_t lsn = 0;
+            codec_t<std::uint64_t>::decode(payload, lsn);
+            if (lsn > snapshot_lsn) {
+                if (lsn != last_lsn + 1) {
+                    throw std::runtime_error("journal: records are missing from " + file);
+                }
+                this->apply(payload);
+                last_lsn = lsn;
+            }
+            offset += 8 + length;
+        }
+        if (truncate && (offset < content.size())) {
+            if (::truncate(file.c_str(), static_cast<off_t>(offset)) != 0) {
+                detail::throw_errno("journal: cannot truncate " + file);
+            }
+        }
+        if (truncate) {
+            log_bytes = offset;
+        }
+        return true;
+    }
+
+    /// @brief Applies the operation stored inside the payload of a record.
+    void apply(std::istream &payload)
+    {
+        std::uint8_t op = 0;
+        codec_t<std::uint8_t>::decode(payload, op);
+        Key key;
+        if (op == op_set) {
+            Value value;
+            codec_t<Key>::decode(payload, key);
+            codec_t<Value>::decode(payload, value);
+            map.set(key, value);
+        } else if (op == op_erase) {
+            codec_t<Key>::decode(payload, key);
+            map.erase(key);
+        } else if (op == op_reorder) {
+            std::uint64_t count = 0;
+            codec_t<std::uint64_t>::decode(payload, count);
+            std::map<Key, std::uint64_t> rank;
+            for (std::uint64_t index = 0; index < count; ++index) {
+                codec_t<Key>::decode(payload, key);
+                rank.emplace(key, index);
+            }
+            map.parallel_sort(
+                [&rank](const typename map_t::list_entry_t &lhs, const typename map_t::list_entry_t &rhs) {
+                    return rank[lhs.first] < rank[rhs.first];
+                },
+                sequential_executor_t());
+        } else if (op == op_clear) {
+            map.clear();
+        } else {
+            throw std::runtime_error("journal: unknown operation");
+        }
+    }
+
+    /// @brief The base path of the files.
+    const std::string path;
+    /// @brief The options of the journal.
+    const options_t options;
+    /// @brief The map.
+    map_t map;
+    /// @brief Protects the map and the state of the journal.
+    mutable std::mutex mutex;
+    /// @brief Notified when a group is written, or a compaction ends.
+    std::condition_variable flushed;
+    /// @brief The records not yet written.
+    std::string pending;
+    /// @brief The sequence number of the last record.
+    std::uint64_t last_lsn;
+    /// @brief The sequence number of the last written record.
+    std::uint64_t written_lsn;
+    /// @brief The sequence number of the last record synchronized with the disk.
+    std::uint64_t synced_lsn;
+    /// @brief If a thread is writing a group.
+    bool flushing;
+    /// @brief The error which failed the journal, if any.
+    std::exception_ptr write_error;
+    /// @brief The descriptor of the current log.
+    int log_descriptor;
+    /// @brief The size of the current log.
+    std::uint64_t log_bytes;
+    /// @brief If a compaction is running.
+    bool compacting;
+    /// @brief The thread running the background compaction.
+    std::thread compactor;
+    /// @brief The error of the last compaction.
+    std::exception_ptr compaction_error;
+};
+
+} // namespace ordered_map
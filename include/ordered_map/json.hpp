@@ -0,0 +1,641 @@
+/// @file json.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A streaming JSON reader and writer, preserving the order of the keys.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+/// @details JSON objects are read into `ordered_map_t<std::string, Value>`,
+/// and written back in insertion order. The type of the values is fixed at
+/// compile time, and converted by a specialization of `json_codec_t<T>`,
+/// providing:
+///  - `static void read(json_reader_t &, T &)`;
+///  - `static void write(json_writer_t &, const T &)`.
+///
+/// Booleans, numbers, `std::string`, `std::vector<T>` (arrays) and
+/// `ordered_map_t<std::string, T>` (nested objects) are supported out of the box.
+///
+
+#pragma once
+
+#include "ordered_map/ordered_map.hpp"
+
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <iterator>
+#include <limits>
+#include <locale>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ordered_map
+{
+
+class json_reader_t;
+class json_writer_t;
+
+/// @brief The codec converting a type from and to JSON, specialize it to support new types.
+/// @tparam T the type.
+template <typename T, typename Enable = void>
+struct json_codec_t;
+
+/// @brief Thrown when the input is not valid JSON, or does not match the expected types.
+class json_error_t : public std::runtime_error
+{
+public:
+    /// @brief Creates the error.
+    /// @param message the description of the error.
+    /// @param _offset the offset of the character where the error was found.
+    json_error_t(const std::string &message, std::size_t _offset)
+        : std::runtime_error("json: " + message + " at offset " + std::to_string(_offset))
+        , offset(_offset)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief The offset of the character where the error was found.
+    std::size_t offset;
+};
+
+/// @brief Reads JSON values from a stream, one character at a time, through
+/// the buffer of the stream.
+/// @details The reader keeps a scratch buffer, reused to decode all the
+/// strings and numbers, so that the only allocations are the ones of the
+/// strings which end up inside the map, which are then moved into place.
+class json_reader_t
+{
+public:
+    /// @brief Creates a reader.
+    /// @param stream the input stream.
+    explicit json_reader_t(std::istream &stream)
+        : buffer(stream.rdbuf())
+        , offset(0)
+        , scratch()
+        , numbers()
+    {
+        numbers.imbue(std::locale::classic());
+    }
+
+    /// @brief Reads a JSON object, setting its members inside the map.
+    /// @param map the map, duplicated keys keep the last value.
+    template <typename Value>
+    void read_object(ordered_map_t<std::string, Value> &map)
+    {
+        std::vector<std::pair<std::string, Value>> members;
+        this->expect('{');
+        if (this->peek() != '}') {
+            do {
+                members.emplace_back();
+                this->read_string(members.back().first);
+                this->expect(':');
+                json_codec_t<Value>::read(*this, members.back().second);
+            } while (this->accept(','));
+        }
+        this->expect('}');
+        map.append(std::make_move_iterator(members.begin()), std::make_move_iterator(members.end()));
+    }
+
+    /// @brief Reads a JSON array.
+    /// @param values where the elements are appended.
+    template <typename Value>
+    void read_array(std::vector<Value> &values)
+    {
+        this->expect('[');
+        if (this->peek() != ']') {
+            do {
+                values.emplace_back();
+                json_codec_t<Value>::read(*this, values.back());
+            } while (this->accept(','));
+        }
+        this->expect(']');
+    }
+
+    /// @brief Reads a JSON string, decoding the escape sequences into UTF-8.
+    /// @param value where the string is stored.
+    void read_string(std::string &value)
+    {
+        this->expect('"');
+        scratch.clear();
+        for (;;) {
+            int current = this->next();
+            if (current == '"') {
+                break;
+            }
+            if (current == '\\') {
+                this->read_escape();
+            } else if ((current == std::char_traits<char>::eof()) || (current < 0x20)) {
+                this->fail("unterminated string");
+            } else {
+                scratch.push_back(static_cast<char>(current));
+            }
+        }
+        value.assign(scratch);
+    }
+
+    /// @brief Reads a JSON boolean.
+    /// @param value where the boolean is stored.
+    void read_bool(bool &value)
+    {
+        if (this->peek() == 't') {
+            this->expect_word("true");
+            value = true;
+        } else {
+            this->expect_word("false");
+            value = false;
+        }
+    }
+
+    /// @brief Reads a JSON number, into an integer or a floating point type.
+    /// @param value where the number is stored.
+    template <typename T>
+    void read_number(T &value)
+    {
+        this->read_number_text();
+        this->convert_number(value, std::is_integral<T>());
+    }
+
+    /// @brief Checks that only whitespaces are left in the stream.
+    void finish()
+    {
+        if (this->peek() != std::char_traits<char>::eof()) {
+            this->fail("unexpected trailing characters");
+        }
+    }
+
+private:
+    /// @brief Throws an error, at the current offset.
+    [[noreturn]] void fail(const std::string &message) const { throw json_error_t(message, offset); }
+
+    /// @brief Returns the next character, and consumes it.
+    auto next() -> int
+    {
+        int current = buffer->sbumpc();
+        offset += (current != std::char_traits<char>::eof()) ? 1 : 0;
+        return current;
+    }
+
+    /// @brief Skips the whitespaces, and returns the next character without consuming it.
+    auto peek() -> int
+    {
+        int current = buffer->sgetc();
+        while ((current == ' ') || (current == '\t') || (current == '\n') || (current == '\r')) {
+            ++offset;
+            current = buffer->snextc();
+        }
+        return current;
+    }
+
+    /// @brief Consumes the given character, after the whitespaces.
+    void expect(char expected)
+    {
+        if (this->peek() != expected) {
+            this->fail(std::string("expected '") + expected + "'");
+        }
+        this->next();
+    }
+
+    /// @brief Consumes the given character if it is the next one.
+    auto accept(char expected) -> bool
+    {
+        if (this->peek() != expected) {
+            return false;
+        }
+        this->next();
+        return true;
+    }
+
+    /// @brief Consumes the given word.
+    void expect_word(const char *word)
+    {
+        this->peek();
+        for (; *word != '\0'; ++word) {
+            if (this->next() != *word) {
+                this->fail("invalid literal");
+            }
+        }
+    }
+
+    /// @brief Reads four hexadecimal digits.
+    auto read_hex() -> unsigned
+    {
+        unsigned result = 0;
+        for (int digit = 0; digit < 4; ++digit) {
+            int current = this->next();
+            result <<= 4U;
+            if ((current >= '0') && (current <= '9')) {
+                result |= static_cast<unsigned>(current - '0');
+            } else if ((current >= 'a') && (current <= 'f')) {
+                result |= static_cast<unsigned>(current - 'a' + 10);
+            } else if ((current >= 'A') && (current <= 'F')) {
+                result |= static_cast<unsigned>(current - 'A' + 10);
+            } else {
+                this->fail("invalid unicode escape");
+            }
+        }
+        return result;
+    }
+
+    /// @brief Decodes an escape sequence into the scratch buffer.
+    void read_escape()
+    {
+        int current = this->next();
+        switch (current) {
+        case '"':
+        case '\\':
+        case '/':
+            scratch.push_back(static_cast<char>(current));
+            break;
+        case 'b':
+            scratch.push_back('\b');
+            break;
+        case 'f':
+            scratch.push_back('\f');
+            break;
+        case 'n':
+            scratch.push_back('\n');
+            break;
+        case 'r':
+            scratch.push_back('\r');
+            break;
+        case 't':
+            scratch.push_back('\t');
+            break;
+        case 'u': {
+            unsigned code = this->read_hex();
+            // Surrogate pairs encode the code points above the BMP.
+            if ((code >= 0xD800) && (code <= 0xDBFF)) {
+                if ((this->next() != '\\') || (this->next() != 'u')) {
+                    this->fail("unpaired surrogate");
+                }
+                unsigned low = this->read_hex();
+                if ((low < 0xDC00) || (low > 0xDFFF)) {
+                    this->fail("unpaired surrogate");
+                }
+                code = 0x10000 + ((code - 0xD800) << 10U) + (low - 0xDC00);
+            } else if ((code >= 0xDC00) && (code <= 0xDFFF)) {
+                this->fail("unpaired surrogate");
+            }
+            this->append_utf8(code);
+            break;
+        }
+        default:
+            this->fail("invalid escape sequence");
+        }
+    }
+
+    /// @brief Encodes the code point into the scratch buffer.
+    void append_utf8(unsigned code)
+    {
+        if (code < 0x80) {
+            scratch.push_back(static_cast<char>(code));
+        } else if (code < 0x800) {
+            scratch.push_back(static_cast<char>(0xC0 | (code >> 6U)));
+            scratch.push_back(static_cast<char>(0x80 | (code & 0x3FU)));
+        } else if (code < 0x10000) {
+            scratch.push_back(static_cast<char>(0xE0 | (code >> 12U)));
+            scratch.push_back(static_cast<char>(0x80 | ((code >> 6U) & 0x3FU)));
+            scratch.push_back(static_cast<char>(0x80 | (code & 0x3FU)));
+        } else {
+            scratch.push_back(static_cast<char>(0xF0 | (code >> 18U)));
+            scratch.push_back(static_cast<char>(0x80 | ((code >> 12U) & 0x3FU)));
+            scratch.push_back(static_cast<char>(0x80 | ((code >> 6U) & 0x3FU)));
+            scratch.push_back(static_cast<char>(0x80 | (code & 0x3FU)));
+        }
+    }
+
+    /// @brief Reads the text of a number into the scratch buffer, checking its syntax.
+    void read_number_text()
+    {
+        scratch.clear();
+        int current = this->peek();
+        // Consumes the digits, and returns how many they were.
+        auto digits = [this, &current]() -> std::size_t {
+            std::size_t count = 0;
+            while ((current >= '0') && (current <= '9')) {
+                scratch.push_back(static_cast<char>(this->next()));
+                current = buffer->sgetc();
+                ++count;
+            }
+            return count;
+        };
+        if (current == '-') {
+            scratch.push_back(static_cast<char>(this->next()));
+            current = buffer->sgetc();
+        }
+        if (current == '0') {
+            scratch.push_back(static_cast<char>(this->next()));
+            current = buffer->sgetc();
+        } else if (digits() == 0) {
+            this->fail("invalid number");
+        }
+        if (current == '.') {
+            scratch.push_back(static_cast<char>(this->next()));
+            current = buffer->sgetc();
+            if (digits() == 0) {
+                this->fail("invalid number");
+            }
+        }
+        if ((current == 'e') || (current == 'E')) {
+            scratch.push_back(static_cast<char>(this->next()));
+            current = buffer->sgetc();
+            if ((current == '+') || (current == '-')) {
+                scratch.push_back(static_cast<char>(this->next()));
+                current = buffer->sgetc();
+            }
+            if (digits() == 0) {
+                this->fail("invalid number");
+            }
+        }
+    }
+
+    /// @brief Converts the number inside the scratch buffer into an integer.
+    template <typename T>
+    void convert_number(T &value, std::true_type)
+    {
+        if (scratch.find_first_of(".eE") != std::string::npos) {
+            this->fail("expected an integer");
+        }
+        errno = 0;
+        char *end = nullptr;
+        if (std::is_signed<T>::value) {
+            long long result = std::strtoll(scratch.c_str(), &end, 10);
+            if ((errno == ERANGE) || (result < static_cast<long long>(std::numeric_limits<T>::min())) ||
+                (result > static_cast<long long>(std::numeric_limits<T>::max()))) {
+                this->fail("integer out of range");
+            }
+            value = static_cast<T>(result);
+        } else {
+            unsigned long long result = std::strtoull(scratch.c_str(), &end, 10);
+            if ((errno == ERANGE) || (scratch[0] == '-') ||
+                (result > static_cast<unsigned long long>(std::numeric_limits<T>::max()))) {
+                this->fail("integer out of range");
+            }
+            value = static_cast<T>(result);
+        }
+    }
+
+    /// @brief Converts the number inside the scratch buffer into a floating
+    /// point, independently of the global locale.
+    template <typename T>
+    void convert_number(T &value, std::false_type)
+    {
+        numbers.clear();
+        numbers.str(scratch);
+        T result = 0;
+        // The stream fails on numbers which overflow the type, such as `1e999`.
+        if (!(numbers >> result) || (numbers.peek() != std::char_traits<char>::eof())) {
+            this->fail("number out of range");
+        }
+        value = result;
+    }
+
+    /// @brief The buffer of the input stream.
+    std::streambuf *buffer;
+    /// @brief The number of consumed characters.
+    std::size_t offset;
+    /// @brief The buffer used to decode strings and numbers.
+    std::string scratch;
+    /// @brief The stream used to convert floating points, with the classic locale.
+    std::istringstream numbers;
+};
+
+/// @brief Writes JSON values into a buffer, which can be reused to avoid allocations.
+class json_writer_t
+{
+public:
+    /// @brief Creates a writer, with an empty buffer.
+    json_writer_t()
+        : output()
+        , numbers()
+    {
+        numbers.imbue(std::locale::classic());
+    }
+
+    /// @brief Writes the map as a JSON object, replacing the content of the buffer.
+    /// @param map the map.
+    /// @return a reference to the buffer.
+    template <typename Value>
+    auto write(const ordered_map_t<std::string, Value> &map) -> const std::string &
+    {
+        output.clear();
+        this->write_object(map);
+        return output;
+    }
+
+    /// @brief Returns the buffer.
+    /// @return a reference to the buffer.
+    auto str() const -> const std::string & { return output; }
+
+    /// @brief Appends a JSON object, with the members in insertion order.
+    /// @param map the map.
+    template <typename Value>
+    void write_object(const ordered_map_t<std::string, Value> &map)
+    {
+        output.push_back('{');
+        for (typename ordered_map_t<std::string, Value>::const_iterator it = map.begin(); it != map.end(); ++it) {
+            if (it != map.begin()) {
+                output.push_back(',');
+            }
+            this->write_string(it->first);
+            output.push_back(':');
+            json_codec_t<Value>::write(*this, it->second);
+        }
+        output.push_back('}');
+    }
+
+    /// @brief Appends a JSON array.
+    /// @param values the elements.
+    template <typename Value>
+    void write_array(const std::vector<Value> &values)
+    {
+        output.push_back('[');
+        for (std::size_t index = 0; index < values.size(); ++index) {
+            if (index > 0) {
+                output.push_back(',');
+            }
+            json_codec_t<Value>::write(*this, values[index]);
+        }
+        output.push_back(']');
+    }
+
+    /// @brief Appends a JSON string, escaping the control characters.
+    /// @param value the string, in UTF-8.
+    void write_string(const std::string &value)
+    {
+        static const char hex[] = "0123456789abcdef";
+        output.push_back('"');
+        std::size_t clean = 0;
+        for (std::size_t index = 0; index < value.size(); ++index) {
+            const auto current = static_cast<unsigned char>(value[index]);
+            if ((current >= 0x20) && (current != '"') && (current != '\\')) {
+                continue;
+            }
+            // Copy the characters which need no escaping in one go.
+            output.append(value, clean, index - clean);
+            clean = index + 1;
+            output.push_back('\\');
+            switch (current) {
+            case '"':
+            case '\\':
+                output.push_back(static_cast<char>(current));
+                break;
+            case '\n':
+                output.push_back('n');
+                break;
+            case '\r':
+                output.push_back('r');
+                break;
+            case '\t':
+                output.push_back('t');
+                break;
+            default:
+                output.append("u00");
+                output.push_back(hex[current >> 4U]);
+                output.push_back(hex[current & 0xFU]);
+            }
+        }
+        output.append(value, clean, value.size() - clean);
+        output.push_back('"');
+    }
+
+    /// @brief Appends a JSON boolean.
+    /// @param value the boolean.
+    void write_bool(bool value) { output.append(value ? "true" : "false"); }
+
+    /// @brief Appends a JSON number.
+    /// @param value the number, which must be finite.
+    /// @throws std::domain_error if the number is not finite.
+    template <typename T>
+    void write_number(T value)
+    {
+        this->write_number(value, std::is_integral<T>());
+    }
+
+private:
+    /// @brief Appends an integer, without going through the locale.
+    template <typename T>
+    void write_number(T value, std::true_type)
+    {
+        char digits[24];
+        std::size_t count = 0;
+        const bool negative = value < 0;
+        // Work on the magnitude as unsigned, so that the minimum value is handled.
+        auto magnitude = static_cast<unsigned long long>(value);
+        if (negative) {
+            magnitude = 0ULL - magnitude;
+        }
+        do {
+            digits[count++] = static_cast<char>('0' + (magnitude % 10));
+            magnitude /= 10;
+        } while (magnitude != 0);
+        if (negative) {
+            output.push_back('-');
+        }
+        while (count > 0) {
+            output.push_back(digits[--count]);
+        }
+    }
+
+    /// @brief Appends a floating point, with enough digits to read it back
+    /// exactly, independently of the global locale.
+    template <typename T>
+    void write_number(T value, std::false_type)
+    {
+        if (!std::isfinite(value)) {
+            throw std::domain_error("json: cannot write a non-finite number");
+        }
+        numbers.str(std::string());
+        numbers.precision(std::numeric_limits<T>::max_digits10);
+        numbers << value;
+        output.append(numbers.str());
+    }
+
+    /// @brief The buffer.
+    std::string output;
+    /// @brief The stream used to convert floating points, with the classic locale.
+    std::ostringstream numbers;
+};
+
+/// @brief Booleans.
+template <>
+struct json_codec_t<bool> {
+    /// @brief Reads the value.
+    static void read(json_reader_t &reader, bool &value) { reader.read_bool(value); }
+    /// @brief Writes the value.
+    static void write(json_writer_t &writer, const bool &value) { writer.write_bool(value); }
+};
+
+/// @brief Integers and floating points.
+template <typename T>
+struct json_codec_t<T, typename std::enable_if<std::is_arithmetic<T>::value && !std::is_same<T, bool>::value>::type> {
+    /// @brief Reads the value.
+    static void read(json_reader_t &reader, T &value) { reader.read_number(value); }
+    /// @brief Writes the value.
+    static void write(json_writer_t &writer, const T &value) { writer.write_number(value); }
+};
+
+/// @brief Strings.
+template <>
+struct json_codec_t<std::string> {
+    /// @brief Reads the value.
+    static void read(json_reader_t &reader, std::string &value) { reader.read_string(value); }
+    /// @brief Writes the value.
+    static void write(json_writer_t &writer, const std::string &value) { writer.write_string(value); }
+};
+
+/// @brief Arrays.
+template <typename T>
+struct json_codec_t<std::vector<T>> {
+    /// @brief Reads the value.
+    static void read(json_reader_t &reader, std::vector<T> &value) { reader.read_array(value); }
+    /// @brief Writes the value.
+    static void write(json_writer_t &writer, const std::vector<T> &value) { writer.write_array(value); }
+};
+
+/// @brief Nested objects.
+template <typename T>
+struct json_codec_t<ordered_map_t<std::string, T>> {
+    /// @brief Reads the value.
+    static void read(json_reader_t &reader, ordered_map_t<std::string, T> &value) { reader.read_object(value); }
+    /// @brief Writes the value.
+    static void write(json_writer_t &writer, const ordered_map_t<std::string, T> &value)
+    {
+        writer.write_object(value);
+    }
+};
+
+/// @brief Reads a JSON document containing an object, replacing the content of the map.
+/// @param stream the input stream.
+/// @param map the map.
+/// @throws json_error_t if the input is not valid. The map is left untouched in that case.
+template <typename Value>
+void read_json(std::istream &stream, ordered_map_t<std::string, Value> &map)
+{
+    json_reader_t reader(stream);
+    ordered_map_t<std::string, Value> result;
+    reader.read_object(result);
+    reader.finish();
+    map = std::move(result);
+}
+
+/// @brief Writes the map as a JSON object, in insertion order.
+/// @param stream the output stream.
+/// @param map the map.
+template <typename Value>
+void write_json(std::ostream &stream, const ordered_map_t<std::string, Value> &map)
+{
+    json_writer_t writer;
+    const std::string &output = writer.write(map);
+    stream.write(output.data(), static_cast<std::streamsize>(output.size()));
+}
+
+} // namespace ordered_map
@@ -0,0 +1,147 @@
+/// @file lz.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A small LZ77 compressor, used for the blocks of the on-disk formats.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+/// @details The compressed data is a sequence of commands, each one made of:
+///  - the number of literals, followed by the literals;
+///  - the length of a match, minus three, or zero for the last command;
+///  - the distance of the match, if any.
+///
+/// All the numbers are stored as LEB128 variable-length integers. Matches are
+/// found with a hash table of the last position of each 4-byte sequence,
+/// inside a 64 KiB window, which favours speed over the compression ratio.
+///
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace ordered_map
+{
+
+namespace detail
+{
+
+/// @brief Appends a variable-length integer to the string.
+/// @param output the string.
+/// @param value the integer.
+inline void lz_append_number(std::string &output, std::uint64_t value)
+{
+    while (value >= 0x80U) {
+        output.push_back(static_cast<char>((value & 0x7FU) | 0x80U));
+        value >>= 7U;
+    }
+    output.push_back(static_cast<char>(value));
+}
+
+/// @brief Reads a variable-length integer from the string.
+/// @param input the string.
+/// @param position the position of the integer, advanced past it.
+/// @return the integer.
+/// @throws std::runtime_error if the string ends before.
+inline auto lz_read_number(const std::string &input, std::size_t &position) -> std::uint64_t
+{
+    std::uint64_t value = 0;
+    for (unsigned shift = 0; (shift < 64) && (position < input.size()); shift += 7) {
+        const auto byte = static_cast<unsigned char>(input[position++]);
+        value |= static_cast<std::uint64_t>(byte & 0x7FU) << shift;
+        if ((byte & 0x80U) == 0) {
+            return value;
+        }
+    }
+    throw std::runtime_error("lz: invalid compressed data");
+}
+
+} // namespace detail
+
+/// @brief Compresses the given bytes.
+/// @param input the bytes.
+/// @return the compressed bytes, which can be larger than the input.
+inline auto lz_compress(const std::string &input) -> std::string
+{
+    const std::size_t min_match = 4;
+    const std::size_t window    = 65535;
+    const unsigned hash_bits    = 13;
+    const std::size_t none      = static_cast<std::size_t>(-1);
+    std::vector<std::size_t> table(std::size_t(1) << hash_bits, none);
+    std::string output;
+    output.reserve(input.size() / 2);
+    std::size_t anchor   = 0;
+    std::size_t position = 0;
+    while (position + min_match <= input.size()) {
+        std::uint32_t word = 0;
+        std::memcpy(&word, &input[position], sizeof(word));
+        const std::size_t slot      = (word * 2654435761U) >> (32U - hash_bits);
+        const std::size_t candidate = table[slot];
+        table[slot]                 = position;
+        if ((candidate == none) || (position - candidate > window) ||
+            (std::memcmp(&input[candidate], &input[position], min_match) != 0)) {
+            ++position;
+            continue;
+        }
+        std::size_t length = min_match;
+        while ((position + length < input.size()) && (input[candidate + length] == input[position + length])) {
+            ++length;
+        }
+        detail::lz_append_number(output, position - anchor);
+        output.append(input, anchor, position - anchor);
+        detail::lz_append_number(output, length - min_match + 1);
+        detail::lz_append_number(output, position - candidate);
+        position += length;
+        anchor = position;
+    }
+    detail::lz_append_number(output, input.size() - anchor);
+    output.append(input, anchor, std::string::npos);
+    detail::lz_append_number(output, 0);
+    return output;
+}
+
+/// @brief Decompresses the bytes produced by `lz_compress`.
+/// @param input the compressed bytes.
+/// @param size the size of the original bytes.
+/// @return the original bytes.
+/// @throws std::runtime_error if the input is not valid, or does not match the size.
+inline auto lz_decompress(const std::string &input, std::size_t size) -> std::string
+{
+    const std::size_t min_match = 4;
+    std::string output;
+    output.reserve(size);
+    std::size_t position = 0;
+    for (;;) {
+        const std::uint64_t literals = detail::lz_read_number(input, position);
+        if ((literals > input.size() - position) || (literals > size - output.size())) {
+            throw std::runtime_error("lz: invalid compressed data");
+        }
+        output.append(input, position, static_cast<std::size_t>(literals));
+        position += static_cast<std::size_t>(literals);
+        const std::uint64_t match = detail::lz_read_number(input, position);
+        if (match == 0) {
+            break;
+        }
+        const std::uint64_t distance = detail::lz_read_number(input, position);
+        if ((match > size) || (match + min_match - 1 > size - output.size()) || (distance == 0) ||
+            (distance > output.size())) {
+            throw std::runtime_error("lz: invalid compressed data");
+        }
+        // The match can overlap the bytes it produces, so it is copied one byte at a time.
+        std::size_t from = output.size() - static_cast<std::size_t>(distance);
+        for (std::size_t length = static_cast<std::size_t>(match) + min_match - 1; length > 0; --length) {
+            const char byte = output[from++];
+            output.push_back(byte);
+        }
+    }
+    if ((output.size() != size) || (position != input.size())) {
+        throw std::runtime_error("lz: invalid compressed data");
+    }
+    return output;
+}
+
+} // namespace ordered_map
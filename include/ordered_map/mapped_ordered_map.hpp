@@ -0,0 +1,505 @@
+/// @file mapped_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A read-only view of an ordered map, served directly from a memory-mapped snapshot.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+/// @details This header requires a POSIX system (`mmap`).
+///
+
+#pragma once
+
+#include "ordered_map/ordered_map.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ordered_map
+{
+
+/// @brief A string stored inside a mapped snapshot.
+class mapped_string_t
+{
+public:
+    /// @brief Creates the string.
+    /// @param _data the first character.
+    /// @param _size the number of characters.
+    mapped_string_t(const char *_data, std::size_t _size)
+        : pointer(_data)
+        , length(_size)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Returns the characters, which are not null-terminated.
+    /// @return a pointer to the first character.
+    auto data() const -> const char * { return pointer; }
+
+    /// @brief Returns the number of characters.
+    /// @return the length of the string.
+    auto size() const -> std::size_t { return length; }
+
+    /// @brief Copies the string.
+    /// @return the copy.
+    auto str() const -> std::string { return std::string(pointer, length); }
+
+    /// @brief Compares the string with a standard string.
+    /// @param other the other string.
+    /// @return true if they contain the same characters.
+    auto operator==(const std::string &other) const -> bool
+    {
+        return (length == other.size()) && (std::memcmp(pointer, other.data(), length) == 0);
+    }
+
+    /// @brief Compares the string with a standard string.
+    /// @param other the other string.
+    /// @return true if they contain different characters.
+    auto operator!=(const std::string &other) const -> bool { return !(*this == other); }
+
+private:
+    /// @brief The first character.
+    const char *pointer;
+    /// @brief The number of characters.
+    std::size_t length;
+};
+
+namespace detail
+{
+
+/// @brief Describes how a type is stored inside a mapped snapshot.
+template <typename T, typename Enable = void>
+struct mapped_field_t;
+
+/// @brief Trivially copyable types are stored as they are, suitably aligned,
+/// and accessed in place. Keys are compared by their object representation,
+/// hence they must not contain padding.
+template <typename T>
+struct mapped_field_t<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type> {
+    /// @brief The type returned when accessing the field.
+    using view_t = const T &;
+    /// @brief The size of the type, zero if variable.
+    static constexpr std::uint64_t fixed_size = sizeof(T);
+    /// @brief The alignment of the field inside the file.
+    static constexpr std::uint64_t alignment = alignof(T);
+
+    /// @brief Returns the bytes of the value.
+    static auto data(const T &value) -> const char * { return reinterpret_cast<const char *>(&value); }
+
+    /// @brief Returns the number of bytes of the value.
+    static auto size(const T &) -> std::size_t { return sizeof(T); }
+
+    /// @brief Accesses the value stored at the given address.
+    static auto view(const char *address, std::size_t) -> view_t { return *reinterpret_cast<const T *>(address); }
+};
+
+/// @brief Strings are stored as their characters.
+template <>
+struct mapped_field_t<std::string> {
+    /// @brief The type returned when accessing the field.
+    using view_t = mapped_string_t;
+    /// @brief The size of the type, zero if variable.
+    static constexpr std::uint64_t fixed_size = 0;
+    /// @brief The alignment of the field inside the file.
+    static constexpr std::uint64_t alignment = 1;
+
+    /// @brief Returns the characters of the string.
+    static auto data(const std::string &value) -> const char * { return value.data(); }
+
+    /// @brief Returns the number of characters of the string.
+    static auto size(const std::string &value) -> std::size_t { return value.size(); }
+
+    /// @brief Accesses the string stored at the given address.
+    static auto view(const char *address, std::size_t size) -> view_t { return mapped_string_t(address, size); }
+};
+
+/// @brief Hashes the given bytes with 64-bit FNV-1a, which does not depend on the process.
+/// @param data the bytes.
+/// @param size the number of bytes.
+/// @return the hash.
+inline auto mapped_hash(const char *data, std::size_t size) -> std::uint64_t
+{
+    std::uint64_t hash = 0xcbf29ce484222325ULL;
+    for (std::size_t index = 0; index < size; ++index) {
+        hash = (hash ^ static_cast<unsigned char>(data[index])) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+} // namespace detail
+
+/// @brief A read-only view of an ordered map, which serves `find`, `at` and
+/// insertion-order iteration directly from a memory-mapped snapshot file.
+/// @details The snapshot is position independent, and contains:
+///  - a header, with the sizes of the other sections;
+///  - the entry array, in insertion order, with the offsets of each key and value;
+///  - a hash index with linear probing, where each slot stores the hash of a
+///    key and the position of its entry;
+///  - the blob with the keys and the values.
+/// Opening a snapshot only maps the file and validates the header, so it takes
+/// constant time; the pages are loaded on demand, and shared between all the
+/// processes mapping the same file. Keys and values can be trivially copyable
+/// types, accessed in place, or `std::string`, accessed as `mapped_string_t`.
+/// The snapshot uses the byte order of the machine which wrote it.
+/// @tparam Key the type of the key.
+/// @tparam Value the value stored inside the map.
+template <typename Key, typename Value>
+class mapped_ordered_map_t
+{
+public:
+    /// @brief The type returned when accessing a key.
+    using key_view_t   = typename detail::mapped_field_t<Key>::view_t;
+    /// @brief The type returned when accessing a value.
+    using value_view_t = typename detail::mapped_field_t<Value>::view_t;
+
+    /// @brief Iterates the entries, in insertion order.
+    class const_iterator
+    {
+    public:
+        /// @brief Returns the key of the current entry.
+        /// @return a view of the key.
+        auto key() const -> key_view_t
+        {
+            return detail::mapped_field_t<Key>::view(
+                owner->base + owner->entries[position].key_offset,
+                static_cast<std::size_t>(owner->entries[position].key_size));
+        }
+
+        /// @brief Returns the value of the current entry.
+        /// @return a view of the value.
+        auto value() const -> value_view_t
+        {
+            return detail::mapped_field_t<Value>::view(
+                owner->base + owner->entries[position].value_offset,
+                static_cast<std::size_t>(owner->entries[position].value_size));
+        }
+
+        /// @brief Moves to the next entry.
+        /// @return a reference to the iterator.
+        auto operator++() -> const_iterator &
+        {
+            ++position;
+            return *this;
+        }
+
+        /// @brief Checks if the two iterators point to the same entry.
+        /// @param other the other iterator.
+        /// @return true if they point to the same entry.
+        auto operator==(const const_iterator &other) const -> bool { return position == other.position; }
+
+        /// @brief Checks if the two iterators point to different entries.
+        /// @param other the other iterator.
+        /// @return true if they point to different entries.
+        auto operator!=(const const_iterator &other) const -> bool { return position != other.position; }
+
+    private:
+        friend class mapped_ordered_map_t;
+
+        /// @brief Creates the iterator.
+        const_iterator(const mapped_ordered_map_t *_owner, std::uint64_t _position)
+            : owner(_owner)
+            , position(_position)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief The map.
+        const mapped_ordered_map_t *owner;
+        /// @brief The position of the entry.
+        std::uint64_t position;
+    };
+
+    /// @brief Writes a snapshot of the given map.
+    /// @param map the map.
+    /// @param path the path of the snapshot.
+    /// @details The snapshot is written to a temporary file, which then
+    /// replaces the given path, so that the processes which mapped the old
+    /// snapshot keep seeing it intact.
+    /// @throws std::runtime_error if the file cannot be written.
+    static void write_snapshot(const ordered_map_t<Key, Value> &map, const std::string &path)
+    {
+        using key_field_t   = detail::mapped_field_t<Key>;
+        using value_field_t = detail::mapped_field_t<Value>;
+        header_t header     = mapped_ordered_map_t::make_header();
+        header.count        = map.size();
+        header.slots        = 16;
+        while (header.slots < (header.count * 2)) {
+            header.slots <<= 1U;
+        }
+        header.entries_offset = sizeof(header_t);
+        header.index_offset   = header.entries_offset + (header.count * sizeof(entry_t));
+        header.blob_offset    = header.index_offset + (header.slots * sizeof(slot_t));
+        // Lay out the blob, and fill the index.
+        std::vector<entry_t> entries;
+        entries.reserve(map.size());
+        std::vector<slot_t> slots(static_cast<std::size_t>(header.slots), slot_t{0, 0});
+        std::uint64_t offset = header.blob_offset;
+        for (typename ordered_map_t<Key, Value>::const_iterator it = map.begin(); it != map.end(); ++it) {
+            entry_t entry;
+            entry.key_offset   = mapped_ordered_map_t::align(offset, key_field_t::alignment);
+            entry.key_size     = key_field_t::size(it->first);
+            entry.value_offset = mapped_ordered_map_t::align(entry.key_offset + entry.key_size, value_field_t::alignment);
+            entry.value_size   = value_field_t::size(it->second);
+            offset             = entry.value_offset + entry.value_size;
+            std::uint64_t hash = detail::mapped_hash(key_field_t::data(it->first), key_field_t::size(it->first));
+            std::uint64_t slot = hash & (header.slots - 1);
+            while (slots[static_cast<std::size_t>(slot)].entry != 0) {
+                slot = (slot + 1) & (header.slots - 1);
+            }
+            slots[static_cast<std::size_t>(slot)] = slot_t{hash, entries.size() + 1};
+            entries.push_back(entry);
+        }
+        header.file_size = offset;
+        // Write everything.
+        const std::string temporary = path + ".tmp";
+        {
+            std::ofstream stream(temporary.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+            if (!stream) {
+                throw std::runtime_error("mapped_ordered_map_t: cannot create " + temporary);
+            }
+            detail::write_bytes(stream, &header, sizeof(header));
+            detail::write_bytes(stream, entries.data(), entries.size() * sizeof(entry_t));
+            detail::write_bytes(stream, slots.data(), slots.size() * sizeof(slot_t));
+            const char padding[16] = {};
+            offset                 = header.blob_offset;
+            std::size_t index      = 0;
+            for (typename ordered_map_t<Key, Value>::const_iterator it = map.begin(); it != map.end(); ++it, ++index) {
+                detail::write_bytes(stream, padding, static_cast<std::size_t>(entries[index].key_offset - offset));
+                detail::write_bytes(stream, key_field_t::data(it->first), key_field_t::size(it->first));
+                offset = entries[index].key_offset + entries[index].key_size;
+                detail::write_bytes(stream, padding, static_cast<std::size_t>(entries[index].value_offset - offset));
+                detail::write_bytes(stream, value_field_t::data(it->second), value_field_t::size(it->second));
+                offset = entries[index].value_offset + entries[index].value_size;
+            }
+            stream.close();
+            if (!stream) {
+                throw std::runtime_error("mapped_ordered_map_t: cannot write " + temporary);
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            throw std::system_error(errno, std::generic_category(), "mapped_ordered_map_t: cannot replace " + path);
+        }
+    }
+
+    /// @brief Maps the given snapshot.
+    /// @param path the path of the snapshot.
+    /// @throws std::system_error if the file cannot be mapped.
+    /// @throws std::runtime_error if the file is not a valid snapshot for this map.
+    explicit mapped_ordered_map_t(const std::string &path)
+        : base(nullptr)
+        , length(0)
+        , header(nullptr)
+        , entries(nullptr)
+        , slots(nullptr)
+    {
+        int descriptor = ::open(path.c_str(), O_RDONLY);
+        if (descriptor < 0) {
+            throw std::system_error(errno, std::generic_category(), "mapped_ordered_map_t: cannot open " + path);
+        }
+        struct stat status;
+        if (::fstat(descriptor, &status) != 0) {
+            int error = errno;
+            ::close(descriptor);
+            throw std::system_error(error, std::generic_category(), "mapped_ordered_map_t: cannot stat " + path);
+        }
+        length = static_cast<std::size_t>(status.st_size);
+        if (length < sizeof(header_t)) {
+            ::close(descriptor);
+            throw std::runtime_error("mapped_ordered_map_t: " + path + " is not a snapshot");
+        }
+        void *address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, descriptor, 0);
+        // The mapping stays valid after closing the descriptor.
+        int error = errno;
+        ::close(descriptor);
+        if (address == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), "mapped_ordered_map_t: cannot map " + path);
+        }
+        base = static_cast<const char *>(address);
+        if (!this->attach()) {
+            ::munmap(address, length);
+            throw std::runtime_error("mapped_ordered_map_t: " + path + " is not a valid snapshot for this map");
+        }
+    }
+
+    /// @brief Move constructor.
+    /// @param other the map to move.
+    mapped_ordered_map_t(mapped_ordered_map_t &&other) noexcept
+        : base(other.base)
+        , length(other.length)
+        , header(other.header)
+        , entries(other.entries)
+        , slots(other.slots)
+    {
+        other.base = nullptr;
+    }
+
+    /// @brief Unmaps the snapshot.
+    ~mapped_ordered_map_t()
+    {
+        if (base != nullptr) {
+            ::munmap(const_cast<char *>(base), length);
+        }
+    }
+
+    mapped_ordered_map_t(const mapped_ordered_map_t &)                     = delete;
+    auto operator=(const mapped_ordered_map_t &) -> mapped_ordered_map_t & = delete;
+    auto operator=(mapped_ordered_map_t &&) -> mapped_ordered_map_t &      = delete;
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t { return static_cast<std::size_t>(header->count); }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty, false otherwise.
+    auto empty() const -> bool { return header->count == 0; }
+
+    /// @brief Returns an iterator to the first entry.
+    /// @return the iterator.
+    auto begin() const -> const_iterator { return const_iterator(this, 0); }
+
+    /// @brief Returns an iterator to the end of the entries.
+    /// @return the iterator.
+    auto end() const -> const_iterator { return const_iterator(this, header->count); }
+
+    /// @brief Searches for the element with the given key.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or `end()` if not found.
+    auto find(const Key &key) const -> const_iterator
+    {
+        using key_field_t      = detail::mapped_field_t<Key>;
+        const char *key_data   = key_field_t::data(key);
+        std::size_t key_size   = key_field_t::size(key);
+        const std::uint64_t hash = detail::mapped_hash(key_data, key_size);
+        for (std::uint64_t slot = hash & (header->slots - 1); slots[slot].entry != 0;
+             slot               = (slot + 1) & (header->slots - 1)) {
+            if (slots[slot].hash == hash) {
+                const entry_t &entry = entries[slots[slot].entry - 1];
+                if ((entry.key_size == key_size) && (std::memcmp(base + entry.key_offset, key_data, key_size) == 0)) {
+                    return const_iterator(this, slots[slot].entry - 1);
+                }
+            }
+        }
+        return this->end();
+    }
+
+    /// @brief Returns the element at the given position, in insertion order.
+    /// @param position the position.
+    /// @return an iterator to the element, or `end()` if out of bounds.
+    auto at(std::size_t position) const -> const_iterator
+    {
+        return const_iterator(this, std::min<std::uint64_t>(position, header->count));
+    }
+
+private:
+    /// @brief The header of the snapshot.
+    struct header_t {
+        /// @brief The magic number, `OMMP`.
+        char magic[4];
+        /// @brief The version of the format.
+        std::uint32_t version;
+        /// @brief The value `0x01020304`, as written by the machine.
+        std::uint32_t byte_order;
+        /// @brief Keeps the next fields aligned.
+        std::uint32_t reserved;
+        /// @brief The size of the keys, zero if variable.
+        std::uint64_t key_size;
+        /// @brief The size of the values, zero if variable.
+        std::uint64_t value_size;
+        /// @brief The number of entries.
+        std::uint64_t count;
+        /// @brief The number of slots of the index, a power of two.
+        std::uint64_t slots;
+        /// @brief The offset of the entry array.
+        std::uint64_t entries_offset;
+        /// @brief The offset of the index.
+        std::uint64_t index_offset;
+        /// @brief The offset of the blob.
+        std::uint64_t blob_offset;
+        /// @brief The size of the whole file.
+        std::uint64_t file_size;
+    };
+
+    /// @brief An entry, with the offsets of its key and value from the beginning of the file.
+    struct entry_t {
+        std::uint64_t key_offset;   ///< The offset of the key.
+        std::uint64_t key_size;     ///< The size of the key.
+        std::uint64_t value_offset; ///< The offset of the value.
+        std::uint64_t value_size;   ///< The size of the value.
+    };
+
+    /// @brief A slot of the index.
+    struct slot_t {
+        std::uint64_t hash;  ///< The hash of the key.
+        std::uint64_t entry; ///< The position of the entry plus one, zero if empty.
+    };
+
+    /// @brief Builds the header identifying snapshots of this map.
+    static auto make_header() -> header_t
+    {
+        header_t result;
+        std::memset(&result, 0, sizeof(result));
+        std::memcpy(result.magic, "OMMP", sizeof(result.magic));
+        result.version    = 1;
+        result.byte_order = 0x01020304;
+        result.key_size   = detail::mapped_field_t<Key>::fixed_size;
+        result.value_size = detail::mapped_field_t<Value>::fixed_size;
+        return result;
+    }
+
+    /// @brief Rounds the offset up to the given alignment.
+    static auto align(std::uint64_t offset, std::uint64_t alignment) -> std::uint64_t
+    {
+        return ((offset + alignment - 1) / alignment) * alignment;
+    }
+
+    /// @brief Validates the header, and locates the sections. The entries
+    /// are not validated one by one, to keep the opening in constant time.
+    /// @return true if the mapping contains a valid snapshot for this map.
+    auto attach() -> bool
+    {
+        header                  = reinterpret_cast<const header_t *>(base);
+        const header_t expected = mapped_ordered_map_t::make_header();
+        if ((std::memcmp(header->magic, expected.magic, sizeof(expected.magic)) != 0) ||
+            (header->version != expected.version) || (header->byte_order != expected.byte_order) ||
+            (header->key_size != expected.key_size) || (header->value_size != expected.value_size)) {
+            return false;
+        }
+        // The sections must follow each other, and fit inside the file.
+        if ((header->slots == 0) || ((header->slots & (header->slots - 1)) != 0) ||
+            (header->slots > (length / sizeof(slot_t))) ||
+            (header->count >= header->slots) || (header->entries_offset != sizeof(header_t)) ||
+            (header->index_offset != header->entries_offset + (header->count * sizeof(entry_t))) ||
+            (header->blob_offset != header->index_offset + (header->slots * sizeof(slot_t))) ||
+            (header->file_size < header->blob_offset) || (header->file_size != length)) {
+            return false;
+        }
+        entries = reinterpret_cast<const entry_t *>(base + header->entries_offset);
+        slots   = reinterpret_cast<const slot_t *>(base + header->index_offset);
+        return true;
+    }
+
+    /// @brief The beginning of the mapping.
+    const char *base;
+    /// @brief The size of the mapping.
+    std::size_t length;
+    /// @brief The header.
+    const header_t *header;
+    /// @brief The entry array.
+    const entry_t *entries;
+    /// @brief The index.
+    const slot_t *slots;
+};
+
+} // namespace ordered_map
@@ -0,0 +1,443 @@
+/// @file mvcc_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A multi-version version of the ordered map, with point-in-time snapshots.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+
+namespace ordered_map
+{
+
+/// @brief An ordered map which keeps multiple versions of its content, so that
+/// readers can iterate a consistent view while writers keep modifying it.
+/// @details Each modification increases the version of the map. Each entry
+/// records the version in which it was inserted and the one in which it was
+/// erased, and keeps a chain of values stamped with the version that set
+/// them. A snapshot is just a version number: it sees the entries alive at
+/// that version, with the value they had. Erasing a key and setting it again
+/// creates a new entry at the end of the insertion order, while the old
+/// entry stays visible to the older snapshots. Entries and values which no
+/// active snapshot can see are reclaimed incrementally by the writers.
+/// All the operations take a short lock, iterators lock only while moving.
+/// @tparam Key the type of the key.
+/// @tparam Value the value stored inside the map.
+template <typename Key, typename Value>
+class mvcc_ordered_map_t
+{
+private:
+    /// @brief A value, stamped with the version which set it.
+    struct value_node_t {
+        /// @brief The version which set the value.
+        std::uint64_t version;
+        /// @brief The value.
+        Value value;
+        /// @brief The previous value.
+        std::unique_ptr<value_node_t> older;
+
+        /// @brief Destroys the value and the older ones.
+        ~value_node_t()
+        {
+            // One node at a time, a recursive destruction of a long chain could overflow the stack.
+            std::unique_ptr<value_node_t> next = std::move(older);
+            while (next) {
+                next = std::move(next->older);
+            }
+        }
+    };
+
+    /// @brief An entry of the map.
+    struct record_t {
+        /// @brief The key.
+        Key key;
+        /// @brief The version which inserted the entry.
+        std::uint64_t created;
+        /// @brief The version which erased the entry, or the maximum value.
+        std::uint64_t erased;
+        /// @brief The values, from the newest to the oldest.
+        std::unique_ptr<value_node_t> values;
+        /// @brief The previous entry with the same key, erased before this one was created.
+        record_t *older;
+
+        /// @brief Checks if the entry is visible at the given version.
+        auto visible_at(std::uint64_t version) const -> bool { return (created <= version) && (version < erased); }
+
+        /// @brief Returns the value at the given version, the entry must be visible.
+        auto value_at(std::uint64_t version) const -> const Value &
+        {
+            const value_node_t *node = values.get();
+            while (node->version > version) {
+                node = node->older.get();
+            }
+            return node->value;
+        }
+    };
+
+    /// @brief The list of the entries, in insertion order.
+    using records_t = std::list<record_t>;
+
+public:
+    class snapshot_t;
+
+    /// @brief Iterates the entries visible to a snapshot, in insertion order.
+    /// @details The iterator is valid as long as its snapshot.
+    class const_iterator
+    {
+    public:
+        /// @brief Returns the key of the current entry.
+        /// @return a reference to the key.
+        auto key() const -> const Key & { return current->key; }
+
+        /// @brief Returns the value of the current entry, at the version of the snapshot.
+        /// @return a reference to the value.
+        auto value() const -> const Value & { return *value_ptr; }
+
+        /// @brief Moves to the next visible entry.
+        /// @return a reference to the iterator.
+        auto operator++() -> const_iterator &
+        {
+            std::lock_guard<std::mutex> lock(owner->mutex);
+            ++current;
+            this->settle();
+            return *this;
+        }
+
+        /// @brief Checks if the two iterators point to the same entry.
+        /// @param other the other iterator.
+        /// @return true if they point to the same entry.
+        auto operator==(const const_iterator &other) const -> bool { return current == other.current; }
+
+        /// @brief Checks if the two iterators point to different entries.
+        /// @param other the other iterator.
+        /// @return true if they point to different entries.
+        auto operator!=(const const_iterator &other) const -> bool { return current != other.current; }
+
+    private:
+        friend class snapshot_t;
+
+        /// @brief Creates the iterator, the lock must be held.
+        const_iterator(const mvcc_ordered_map_t *_owner, std::uint64_t _version, typename records_t::const_iterator _current)
+            : owner(_owner)
+            , version(_version)
+            , current(_current)
+            , value_ptr(nullptr)
+        {
+            this->settle();
+        }
+
+        /// @brief Skips the entries not visible to the snapshot, the lock must be held.
+        void settle()
+        {
+            while ((current != owner->records.end()) && !current->visible_at(version)) {
+                ++current;
+            }
+            value_ptr = (current != owner->records.end()) ? &current->value_at(version) : nullptr;
+        }
+
+        /// @brief The map.
+        const mvcc_ordered_map_t *owner;
+        /// @brief The version of the snapshot.
+        std::uint64_t version;
+        /// @brief The current entry.
+        typename records_t::const_iterator current;
+        /// @brief The value of the current entry.
+        const Value *value_ptr;
+    };
+
+    /// @brief A point-in-time, read-only, view of the map.
+    /// @details While the snapshot is alive, the entries and values it can
+    /// see are not reclaimed.
+    class snapshot_t
+    {
+    public:
+        /// @brief Move constructor.
+        /// @param other the snapshot to move.
+        snapshot_t(snapshot_t &&other) noexcept
+            : owner(other.owner)
+            , stamp(other.stamp)
+        {
+            other.owner = nullptr;
+        }
+
+        /// @brief Releases the snapshot.
+        ~snapshot_t()
+        {
+            if (owner != nullptr) {
+                std::lock_guard<std::mutex> lock(owner->mutex);
+                owner->active.erase(owner->active.find(stamp));
+            }
+        }
+
+        snapshot_t(const snapshot_t &)                     = delete;
+        auto operator=(const snapshot_t &) -> snapshot_t & = delete;
+        auto operator=(snapshot_t &&) -> snapshot_t &      = delete;
+
+        /// @brief Returns the version seen by the snapshot.
+        /// @return the version.
+        auto version() const -> std::uint64_t { return stamp; }
+
+        /// @brief Returns an iterator to the first visible entry.
+        /// @return the iterator.
+        auto begin() const -> const_iterator
+        {
+            std::lock_guard<std::mutex> lock(owner->mutex);
+            return const_iterator(owner, stamp, owner->records.begin());
+        }
+
+        /// @brief Returns an iterator to the end of the entries.
+        /// @return the iterator.
+        auto end() const -> const_iterator
+        {
+            std::lock_guard<std::mutex> lock(owner->mutex);
+            return const_iterator(owner, stamp, owner->records.end());
+        }
+
+        /// @brief Copies the value associated with the given key, at the version of the snapshot.
+        /// @param key the key of the element to search for.
+        /// @param value where the value is copied, if found.
+        /// @return true if the key was found, false otherwise.
+        auto find(const Key &key, Value &value) const -> bool
+        {
+            std::lock_guard<std::mutex> lock(owner->mutex);
+            return owner->lookup(key, stamp, value);
+        }
+
+    private:
+        friend class mvcc_ordered_map_t;
+
+        /// @brief Creates the snapshot, the lock must be held.
+        snapshot_t(mvcc_ordered_map_t *_owner, std::uint64_t _stamp)
+            : owner(_owner)
+            , stamp(_stamp)
+        {
+            owner->active.insert(stamp);
+        }
+
+        /// @brief The map.
+        mvcc_ordered_map_t *owner;
+        /// @brief The version seen by the snapshot.
+        std::uint64_t stamp;
+    };
+
+    /// @brief Construct a new, empty, map.
+    mvcc_ordered_map_t()
+        : records()
+        , table()
+        , active()
+        , current(0)
+        , count(0)
+        , cursor()
+        , mutex()
+    {
+        cursor = records.end();
+    }
+
+    mvcc_ordered_map_t(const mvcc_ordered_map_t &)                     = delete;
+    mvcc_ordered_map_t(mvcc_ordered_map_t &&)                          = delete;
+    auto operator=(const mvcc_ordered_map_t &) -> mvcc_ordered_map_t & = delete;
+    auto operator=(mvcc_ordered_map_t &&) -> mvcc_ordered_map_t &      = delete;
+
+    /// @brief Returns the current version of the map.
+    /// @return the version.
+    auto version() const -> std::uint64_t
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return current;
+    }
+
+    /// @brief Returns the number of element in the current version of the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return count;
+    }
+
+    /// @brief Returns the number of entries and values kept in memory,
+    /// including the ones kept only for the snapshots.
+    /// @return the number of entries and the number of values.
+    auto footprint() const -> std::pair<std::size_t, std::size_t>
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::size_t values = 0;
+        for (const record_t &record : records) {
+            for (const value_node_t *node = record.values.get(); node != nullptr; node = node->older.get()) {
+                ++values;
+            }
+        }
+        return std::make_pair(records.size(), values);
+    }
+
+    /// @brief Takes a snapshot of the current version.
+    /// @return the snapshot.
+    auto snapshot() -> snapshot_t
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return snapshot_t(this, current);
+    }
+
+    /// @brief Copies the value associated with the given key, in the current version.
+    /// @param key the key of the element to search for.
+    /// @param value where the value is copied, if found.
+    /// @return true if the key was found, false otherwise.
+    auto find(const Key &key, Value &value) const -> bool
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return this->lookup(key, current, value);
+    }
+
+    /// @brief Sets/updates the `<key,value>` pair, creating a new version.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    void set(const Key &key, const Value &value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::uint64_t version                           = ++current;
+        typename std::map<Key, record_t *>::iterator it = table.find(key);
+        if ((it != table.end()) && (it->second->erased == infinity)) {
+            record_t *record = it->second;
+            record->values.reset(new value_node_t{version, value, std::move(record->values)});
+        } else {
+            records.push_back(record_t{key, version, infinity, nullptr, nullptr});
+            record_t *record = &records.back();
+            record->values.reset(new value_node_t{version, value, nullptr});
+            if (it != table.end()) {
+                record->older = it->second;
+                it->second    = record;
+            } else {
+                table.emplace(key, record);
+            }
+            ++count;
+        }
+        this->collect_some(gc_steps);
+    }
+
+    /// @brief Erases the given key, creating a new version.
+    /// @param key the key of the element to remove.
+    /// @return true if the element was removed, false otherwise.
+    auto erase(const Key &key) -> bool
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        typename std::map<Key, record_t *>::iterator it = table.find(key);
+        if ((it == table.end()) || (it->second->erased != infinity)) {
+            return false;
+        }
+        it->second->erased = ++current;
+        --count;
+        this->collect_some(gc_steps);
+        return true;
+    }
+
+    /// @brief Reclaims all the entries and values no snapshot can see.
+    void collect()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        cursor = records.begin();
+        this->collect_some(records.size());
+    }
+
+private:
+    /// @brief Marks the entries which have not been erased.
+    static constexpr std::uint64_t infinity = std::numeric_limits<std::uint64_t>::max();
+    /// @brief The number of entries examined by each modification.
+    static constexpr std::size_t gc_steps   = 4;
+
+    /// @brief Searches the value of the key at the given version, the lock must be held.
+    auto lookup(const Key &key, std::uint64_t version, Value &value) const -> bool
+    {
+        typename std::map<Key, record_t *>::const_iterator it = table.find(key);
+        if (it == table.end()) {
+            return false;
+        }
+        for (const record_t *record = it->second; record != nullptr; record = record->older) {
+            if (record->visible_at(version)) {
+                value = record->value_at(version);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Examines the given number of entries, starting from the cursor,
+    /// and reclaims what no snapshot can see, the lock must be held.
+    void collect_some(std::size_t steps)
+    {
+        // Nobody can see anything older than the oldest snapshot.
+        const std::uint64_t oldest = active.empty() ? current : *active.begin();
+        for (std::size_t step = 0; (step < steps) && !records.empty(); ++step) {
+            if (cursor == records.end()) {
+                cursor = records.begin();
+            }
+            record_t &record = *cursor;
+            if (record.erased <= oldest) {
+                this->unlink(record);
+                cursor = records.erase(cursor);
+                continue;
+            }
+            // Keep the newest value visible to the oldest snapshot, and the newer ones.
+            value_node_t *node = record.values.get();
+            while ((node != nullptr) && (node->version > oldest)) {
+                node = node->older.get();
+            }
+            if (node != nullptr) {
+                // The destructor of the nodes frees the chain with a loop.
+                node->older.reset();
+            }
+            ++cursor;
+        }
+    }
+
+    /// @brief Removes the entry from the chain of entries with the same key.
+    void unlink(record_t &record)
+    {
+        typename std::map<Key, record_t *>::iterator it = table.find(record.key);
+        if (it->second == &record) {
+            if (record.older != nullptr) {
+                it->second = record.older;
+            } else {
+                table.erase(it);
+            }
+            return;
+        }
+        record_t *newer = it->second;
+        while (newer->older != &record) {
+            newer = newer->older;
+        }
+        newer->older = record.older;
+    }
+
+    /// @brief The entries, in insertion order.
+    records_t records;
+    /// @brief Associates each key with its newest entry.
+    std::map<Key, record_t *> table;
+    /// @brief The versions of the active snapshots.
+    std::multiset<std::uint64_t> active;
+    /// @brief The current version.
+    std::uint64_t current;
+    /// @brief The number of elements in the current version.
+    std::size_t count;
+    /// @brief The position of the incremental reclamation.
+    typename records_t::iterator cursor;
+    /// @brief Protects the map.
+    mutable std::mutex mutex;
+};
+
+template <typename Key, typename Value>
+constexpr std::uint64_t mvcc_ordered_map_t<Key, Value>::infinity;
+
+template <typename Key, typename Value>
+constexpr std::size_t mvcc_ordered_map_t<Key, Value>::gc_steps;
+
+} // namespace ordered_map
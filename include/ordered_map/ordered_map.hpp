@@ -8,9 +8,22 @@
 
 #pragma once
 
+#include "ordered_map/codec.hpp"
+#include "ordered_map/executor.hpp"
+#include "ordered_map/work_stealing_pool.hpp"
+
+#include <algorithm>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <istream>
+#include <iterator>
 #include <list>
 #include <map>
+#include <ostream>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
 
 enum : std::uint8_t {
     ORDERED_MAP_MAJOR_VERSION = 1, ///< Major version of the library.
@@ -52,14 +65,16 @@ public:
     /// @param other a reference to the map to copy.
     /// @details I had to define one, otherwise copying this map will screw up
     /// the copy of the iterators contained inside the `std::map`. That is why,
-    /// here I copy each individual element of the list and store the iterator,
-    /// again.
+    /// here I copy the list, and then I rebuild the table by following the
+    /// (already sorted) keys of the other table, so that each insertion is
+    /// hinted at the end and takes constant time.
     ordered_map_t(const ordered_map_t &other)
-        : list()
+        : list(other.list)
         , table()
     {
-        for (const auto &entry : other.list) {
-            table.insert({entry.first, list.insert(list.end(), entry)});
+        entry_remap_t remap(other.list, list);
+        for (table_const_iterator it_table = other.table.begin(); it_table != other.table.end(); ++it_table) {
+            table.emplace_hint(table.end(), it_table->first, remap(*it_table->second));
         }
     }
 
@@ -129,6 +144,55 @@ public:
         return it_list;
     }
 
+    /// @brief Appends a range of `<key,value>` pairs in bulk.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    /// @details The result is the same as calling `set` on each pair of the
+    /// range, in order. The pairs are copied (or moved, when using a
+    /// `std::move_iterator`) into new list nodes, which are sorted by key, so
+    /// that the table is searched only when the new keys interleave with the
+    /// existing ones, and hinted at the end otherwise.
+    template <typename InputIterator>
+    void append(InputIterator first, InputIterator last)
+    {
+        list_t added(first, last);
+        std::vector<iterator> entries;
+        entries.reserve(added.size());
+        for (iterator it = added.begin(); it != added.end(); ++it) {
+            entries.push_back(it);
+        }
+        // Stable, so that equal keys keep the order of the range.
+        std::stable_sort(entries.begin(), entries.end(), [](const iterator &lhs, const iterator &rhs) {
+            return lhs->first < rhs->first;
+        });
+        for (std::size_t index = 0; index < entries.size();) {
+            std::size_t end = index + 1;
+            while ((end < entries.size()) && !(entries[index]->first < entries[end]->first)) {
+                ++end;
+            }
+            const Key &key = entries[index]->first;
+            // New keys usually come after the existing ones.
+            table_iterator hint = table.end();
+            if (!table.empty() && !(table.rbegin()->first < key)) {
+                hint = table.lower_bound(key);
+            }
+            const bool existing = (hint != table.end()) && !(key < hint->first);
+            // The value is the last one, the position is the first one.
+            iterator target     = existing ? hint->second : entries[index];
+            if (target != entries[end - 1]) {
+                target->second = std::move(entries[end - 1]->second);
+            }
+            for (std::size_t other = existing ? index : index + 1; other < end; ++other) {
+                added.erase(entries[other]);
+            }
+            if (!existing) {
+                table.emplace_hint(hint, target->first, target);
+            }
+            index = end;
+        }
+        list.splice(list.end(), added);
+    }
+
     /// @brief Returns an iterator the beginning of the list.
     /// @return an iterator to the beginning of the list.
     auto begin() -> iterator { return list.begin(); }
@@ -178,6 +242,65 @@ public:
         return it_list;
     }
 
+    /// @brief Erases all the elements that satisfy the given predicate.
+    /// @param pred the predicate, called once on each `list_entry_t`.
+    /// @details The elements are visited with a single pass over the table,
+    /// which already holds the list iterator of each element. Thus, both the
+    /// list node and the table node are unlinked directly, without searching
+    /// the key again. The predicate is called following the key order.
+    /// @return the number of erased elements.
+    template <typename Predicate>
+    auto erase_if(Predicate pred) -> std::size_t
+    {
+        std::size_t count = 0;
+        for (table_iterator it_table = table.begin(); it_table != table.end();) {
+            if (pred(static_cast<const list_entry_t &>(*it_table->second))) {
+                list.erase(it_table->second);
+                it_table = table.erase(it_table);
+                ++count;
+            } else {
+                ++it_table;
+            }
+        }
+        return count;
+    }
+
+    /// @brief Erases all the elements associated with the keys in the given range.
+    /// @param first the beginning of the range of keys.
+    /// @param last the end of the range of keys.
+    /// @details The keys are sorted, then merged with the table in a single
+    /// pass in key order: the table is walked forward from the last position,
+    /// and searched from the root only when the next key is more than a few
+    /// elements away. Thus, dense batches cost a linear merge, and sparse ones
+    /// a search per key. The elements are removed from both the list and the
+    /// table through the iterators found. Duplicated keys are ignored.
+    /// @return the number of erased elements.
+    template <typename InputIterator>
+    auto erase_keys(InputIterator first, InputIterator last) -> std::size_t
+    {
+        const std::size_t merge_steps = 8;
+        std::vector<Key> keys(first, last);
+        std::sort(keys.begin(), keys.end());
+        std::size_t count       = 0;
+        table_iterator it_table = table.begin();
+        for (const Key &key : keys) {
+            std::size_t steps = 0;
+            while ((it_table != table.end()) && (it_table->first < key) && (steps < merge_steps)) {
+                ++it_table;
+                ++steps;
+            }
+            if ((it_table != table.end()) && (it_table->first < key)) {
+                it_table = table.lower_bound(key);
+            }
+            if ((it_table != table.end()) && !(key < it_table->first)) {
+                list.erase(it_table->second);
+                it_table = table.erase(it_table);
+                ++count;
+            }
+        }
+        return count;
+    }
+
     /// @brief Returns an iterator to the element in the given position.
     /// @param position the position of the element to retrieve.
     /// @return an iterator to the element, or the end of the list if not found.
@@ -226,19 +349,368 @@ public:
     /// @param fun the sorting function.
     void sort(const sort_function_t &fun) { list.sort(fun); }
 
+    /// @brief Sorts the internal list, in parallel.
+    /// @param fun the sorting function, called as `fun(const list_entry_t &, const list_entry_t &)`.
+    /// @param executor the executor running the parallel tasks.
+    /// @details The iterators of the entries are gathered inside a contiguous
+    /// buffer, which is sorted with a parallel (stable) merge sort. Then, the
+    /// list is relinked in a single pass. Since the entries are not moved, the
+    /// table and all the iterators stay valid. Gathering and relinking are
+    /// serial O(n) passes on the calling thread, only the sort is parallel.
+    template <typename Compare, typename Executor>
+    void parallel_sort(Compare fun, const Executor &executor)
+    {
+        std::vector<iterator> entries;
+        entries.reserve(list.size());
+        for (iterator it = list.begin(); it != list.end(); ++it) {
+            entries.push_back(it);
+        }
+        auto less = [&fun](const iterator &lhs, const iterator &rhs) { return fun(*lhs, *rhs); };
+        // Sort each run on its own.
+        const std::size_t count = entries.size();
+        const std::size_t runs  = std::max<std::size_t>(1, std::min<std::size_t>(executor.concurrency(), count / 1024));
+        auto run_begin          = [count, runs](std::size_t run) { return (std::min(run, runs) * count) / runs; };
+        executor.parallel_for(runs, [&](std::size_t run) {
+            std::stable_sort(
+                entries.begin() + static_cast<std::ptrdiff_t>(run_begin(run)),
+                entries.begin() + static_cast<std::ptrdiff_t>(run_begin(run + 1)), less);
+        });
+        // Merge pairs of adjacent runs, doubling their width at each round.
+        std::vector<iterator> buffer(count);
+        for (std::size_t width = 1; width < runs; width *= 2) {
+            executor.parallel_for((runs + (2 * width) - 1) / (2 * width), [&](std::size_t pair) {
+                auto begin  = static_cast<std::ptrdiff_t>(run_begin(pair * 2 * width));
+                auto middle = static_cast<std::ptrdiff_t>(run_begin((pair * 2 * width) + width));
+                auto end    = static_cast<std::ptrdiff_t>(run_begin((pair + 1) * 2 * width));
+                std::merge(
+                    entries.begin() + begin, entries.begin() + middle, entries.begin() + middle, entries.begin() + end,
+                    buffer.begin() + begin, less);
+            });
+            entries.swap(buffer);
+        }
+        // Relink the list, following the sorted order.
+        for (const iterator &it : entries) {
+            list.splice(list.end(), list, it);
+        }
+    }
+
+    /// @brief Sorts the internal list, in parallel.
+    /// @param fun the sorting function, called as `fun(const list_entry_t &, const list_entry_t &)`.
+    /// @details It uses the `work_stealing_pool_t` returned by `default_pool()`.
+    template <typename Compare>
+    void parallel_sort(Compare fun)
+    {
+        this->parallel_sort(fun, default_pool());
+    }
+
+    /// @brief Calls the given function on each element, in parallel.
+    /// @param fun the function, called as `fun(list_entry_t &)`, it must not
+    /// change the key of the element.
+    /// @param executor the executor running the parallel tasks.
+    /// @details The list is split into chunks of `parallel_grain` elements,
+    /// which are processed as independent tasks. The list has no positional
+    /// index, so finding the chunks is a serial O(n) pass on the calling
+    /// thread (see `chunk_bounds`), done before any task starts: the speedup
+    /// is bounded for cheap functions, where the walk costs as much as the work.
+    template <typename Function, typename Executor>
+    void parallel_for_each(Function fun, const Executor &executor)
+    {
+        std::vector<iterator> bounds = this->chunk_bounds();
+        executor.parallel_for(bounds.size() - 1, [&](std::size_t chunk) {
+            for (iterator it = bounds[chunk]; it != bounds[chunk + 1]; ++it) {
+                fun(*it);
+            }
+        });
+    }
+
+    /// @brief Calls the given function on each element, in parallel.
+    /// @param fun the function, called as `fun(list_entry_t &)`, it must not
+    /// change the key of the element.
+    /// @details It uses the `work_stealing_pool_t` returned by `default_pool()`.
+    template <typename Function>
+    void parallel_for_each(Function fun)
+    {
+        this->parallel_for_each(fun, default_pool());
+    }
+
+    /// @brief Replaces each value with the result of the given function, in parallel.
+    /// @param fun the function, called as `fun(const list_entry_t &)`, it
+    /// returns the new value.
+    /// @param executor the executor running the parallel tasks.
+    /// @details The chunks are found as in `parallel_for_each`, with a serial
+    /// O(n) pass on the calling thread.
+    template <typename Function, typename Executor>
+    void parallel_transform_values(Function fun, const Executor &executor)
+    {
+        this->parallel_for_each(
+            [&fun](list_entry_t &entry) { entry.second = fun(static_cast<const list_entry_t &>(entry)); }, executor);
+    }
+
+    /// @brief Replaces each value with the result of the given function, in parallel.
+    /// @param fun the function, called as `fun(const list_entry_t &)`, it
+    /// returns the new value.
+    /// @details It uses the `work_stealing_pool_t` returned by `default_pool()`.
+    template <typename Function>
+    void parallel_transform_values(Function fun)
+    {
+        this->parallel_transform_values(fun, default_pool());
+    }
+
+    /// @brief Reduces the elements to a single value, in parallel.
+    /// @param identity the identity of the reduction.
+    /// @param map the function, called as `map(const list_entry_t &)`,
+    /// which turns each element into a partial result of type `T`.
+    /// @param reduce the function, called as `reduce(T, T)`, which combines
+    /// two partial results, it must be associative.
+    /// @param executor the executor running the parallel tasks.
+    /// @details The chunks do not depend on the number of threads, and their
+    /// results are combined following the insertion order. Thus, the result
+    /// is deterministic, even for reductions which are only approximately
+    /// associative, such as floating-point sums. The chunks are found as in
+    /// `parallel_for_each`, with a serial O(n) pass on the calling thread.
+    /// @return the result of the reduction.
+    template <typename T, typename Map, typename Reduce, typename Executor>
+    auto parallel_reduce(T identity, Map map, Reduce reduce, const Executor &executor) const -> T
+    {
+        std::vector<const_iterator> bounds = this->chunk_bounds();
+        std::vector<T> partials(bounds.size() - 1, identity);
+        executor.parallel_for(bounds.size() - 1, [&](std::size_t chunk) {
+            T partial = identity;
+            for (const_iterator it = bounds[chunk]; it != bounds[chunk + 1]; ++it) {
+                partial = reduce(partial, map(*it));
+            }
+            partials[chunk] = partial;
+        });
+        T result = identity;
+        for (const T &partial : partials) {
+            result = reduce(result, partial);
+        }
+        return result;
+    }
+
+    /// @brief Reduces the elements to a single value, in parallel.
+    /// @param identity the identity of the reduction.
+    /// @param map the function turning each element into a partial result.
+    /// @param reduce the function combining two partial results.
+    /// @details It uses the `work_stealing_pool_t` returned by `default_pool()`.
+    /// @return the result of the reduction.
+    template <typename T, typename Map, typename Reduce>
+    auto parallel_reduce(T identity, Map map, Reduce reduce) const -> T
+    {
+        return this->parallel_reduce(identity, map, reduce, default_pool());
+    }
+
+    /// @brief Builds a map from a range of `<key,value>` pairs, in parallel.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    /// @param executor the executor running the parallel tasks.
+    /// @details The result is the same as calling `set` on each pair of the
+    /// range, in order: each key takes the position of its first occurrence,
+    /// and the value of its last one. The pairs are partitioned by key range,
+    /// using splitters sampled from the input, and each partition is sorted
+    /// and deduplicated in parallel. Since partitions follow the key order,
+    /// the table is then built with constant-time hinted insertions, while the
+    /// list is stitched together following the input order.
+    /// @return the new map.
+    template <typename RandomIterator, typename Executor>
+    static auto parallel_build(RandomIterator first, RandomIterator last, const Executor &executor) -> ordered_map_t
+    {
+        const auto count = static_cast<std::size_t>(std::distance(first, last));
+        const std::size_t parts =
+            std::max<std::size_t>(1, std::min<std::size_t>(executor.concurrency(), count / 1024));
+        auto key_at = [first](std::size_t position) -> const Key & {
+            return (first + static_cast<std::ptrdiff_t>(position))->first;
+        };
+        // Sample the input, and pick the splitters between the partitions.
+        std::vector<std::size_t> splitters;
+        if (parts > 1) {
+            std::vector<std::size_t> sample;
+            const std::size_t sample_size = std::min(count, parts * 32);
+            for (std::size_t index = 0; index < sample_size; ++index) {
+                sample.push_back((index * count) / sample_size);
+            }
+            std::sort(sample.begin(), sample.end(), [&key_at](std::size_t lhs, std::size_t rhs) {
+                return key_at(lhs) < key_at(rhs);
+            });
+            for (std::size_t part = 1; part < parts; ++part) {
+                splitters.push_back(sample[(part * sample_size) / parts]);
+            }
+        }
+        // Each chunk of the input distributes its positions to the partitions.
+        std::vector<std::vector<std::vector<std::size_t>>> buckets(parts, std::vector<std::vector<std::size_t>>(parts));
+        executor.parallel_for(parts, [&](std::size_t chunk) {
+            for (std::size_t position = (chunk * count) / parts; position < ((chunk + 1) * count) / parts; ++position) {
+                const std::size_t part = static_cast<std::size_t>(
+                    std::upper_bound(
+                        splitters.begin(), splitters.end(), position,
+                        [&key_at](std::size_t lhs, std::size_t rhs) { return key_at(lhs) < key_at(rhs); }) -
+                    splitters.begin());
+                buckets[chunk][part].push_back(position);
+            }
+        });
+        // Each partition is sorted by key, keeping the input order between
+        // equal keys. Then, for each key we mark the position of its first
+        // occurrence with the position of its last one.
+        std::vector<std::vector<std::size_t>> sorted(parts);
+        std::vector<std::size_t> last_of(count, count);
+        executor.parallel_for(parts, [&](std::size_t part) {
+            std::vector<std::size_t> &positions = sorted[part];
+            for (std::size_t chunk = 0; chunk < parts; ++chunk) {
+                positions.insert(positions.end(), buckets[chunk][part].begin(), buckets[chunk][part].end());
+                std::vector<std::size_t>().swap(buckets[chunk][part]);
+            }
+            std::stable_sort(positions.begin(), positions.end(), [&key_at](std::size_t lhs, std::size_t rhs) {
+                return key_at(lhs) < key_at(rhs);
+            });
+            std::size_t unique = 0;
+            for (std::size_t index = 0; index < positions.size();) {
+                std::size_t end = index + 1;
+                while ((end < positions.size()) && !(key_at(positions[index]) < key_at(positions[end]))) {
+                    ++end;
+                }
+                last_of[positions[index]] = positions[end - 1];
+                positions[unique++]       = positions[index];
+                index                     = end;
+            }
+            positions.resize(unique);
+        });
+        // Stitch the list together following the input order.
+        ordered_map_t result;
+        std::vector<iterator> entries(count);
+        for (std::size_t position = 0; position < count; ++position) {
+            if (last_of[position] != count) {
+                entries[position] = result.list.emplace(
+                    result.list.end(), key_at(position),
+                    (first + static_cast<std::ptrdiff_t>(last_of[position]))->second);
+            }
+        }
+        // Partitions are in key order, and each one is sorted.
+        for (std::size_t part = 0; part < parts; ++part) {
+            for (std::size_t position : sorted[part]) {
+                result.table.emplace_hint(result.table.end(), key_at(position), entries[position]);
+            }
+        }
+        return result;
+    }
+
+    /// @brief Builds a map from a range of `<key,value>` pairs, in parallel.
+    /// @param first the beginning of the range.
+    /// @param last the end of the range.
+    /// @details It uses the `work_stealing_pool_t` returned by `default_pool()`.
+    /// @return the new map.
+    template <typename RandomIterator>
+    static auto parallel_build(RandomIterator first, RandomIterator last) -> ordered_map_t
+    {
+        return ordered_map_t::parallel_build(first, last, default_pool());
+    }
+
+    /// @brief Writes the map to a stream, using a compact binary format.
+    /// @param stream the output stream, which should be opened in binary mode.
+    /// @details The format starts with a header, containing a magic number,
+    /// the version of the format, a byte-order mark, the sizes of the keys and
+    /// values (zero when they are stored by a custom codec) and the number of
+    /// entries. Then, the entries follow in insertion order, each one encoded
+    /// by the `codec_t` of its key and value. When both codecs store the object
+    /// representation, entries are copied in blocks with `memcpy`.
+    /// @throws std::runtime_error if the stream fails.
+    void save(std::ostream &stream) const
+    {
+        const serial_header_t header = ordered_map_t::make_serial_header(list.size());
+        detail::write_bytes(stream, &header, sizeof(header));
+        this->save_entries(stream, is_raw_entry<Key, Value>());
+    }
+
+    /// @brief Replaces the content of the map with the one read from a stream.
+    /// @param stream the input stream, written by `save`.
+    /// @details The list is filled in insertion order, then the table is built
+    /// by sorting the entries by key, and inserting them with constant-time
+    /// hinted insertions, instead of searching each key. If the stream is not
+    /// valid, the map is left untouched.
+    /// @throws std::runtime_error if the stream is truncated, contains
+    /// duplicated keys, or was written with an incompatible format.
+    void load(std::istream &stream)
+    {
+        serial_header_t header;
+        detail::read_bytes(stream, &header, sizeof(header));
+        const serial_header_t expected = ordered_map_t::make_serial_header(header.count);
+        if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0) {
+            throw std::runtime_error("ordered_map: the stream does not contain a map");
+        }
+        if ((header.version != expected.version) || (header.byte_order != expected.byte_order)) {
+            throw std::runtime_error("ordered_map: unsupported format version or byte order");
+        }
+        if ((header.key_size != expected.key_size) || (header.value_size != expected.value_size)) {
+            throw std::runtime_error("ordered_map: the stream contains different types");
+        }
+        ordered_map_t result;
+        // A corrupted count must not exhaust the memory before failing.
+        std::vector<iterator> entries;
+        entries.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(header.count, 1U << 20U)));
+        result.load_entries(stream, header.count, entries, is_raw_entry<Key, Value>());
+        std::sort(entries.begin(), entries.end(), [](const iterator &lhs, const iterator &rhs) {
+            return lhs->first < rhs->first;
+        });
+        for (std::size_t index = 0; index < entries.size(); ++index) {
+            if ((index > 0) && !(entries[index - 1]->first < entries[index]->first)) {
+                throw std::runtime_error("ordered_map: the stream contains duplicated keys");
+            }
+            result.table.emplace_hint(result.table.end(), entries[index]->first, entries[index]);
+        }
+        *this = std::move(result);
+    }
+
     /// @brief Assign operator.
     /// @param other a reference to the map to copy.
     /// @details I had to define one, otherwise copying this map will screw up
-    /// the copy of the iterators contained inside the `std::map`. That is why,
-    /// here I copy each individual element of the list and store the iterator,
-    /// again.
+    /// the copy of the iterators contained inside the `std::map`. The nodes
+    /// already owned by this list are overwritten instead of being freed and
+    /// allocated again, and the table is rebuilt with hinted insertions (when
+    /// compiling with C++17, the nodes of the table are recycled as well).
+    /// If copying an element throws, the map is left empty.
     /// @return a reference to the current map.
     auto operator=(const ordered_map_t &other) -> ordered_map_t &
     {
         if (this != &other) {
-            this->clear();
-            for (const auto &entry : other.list) {
-                table.insert({entry.first, list.insert(list.end(), entry)});
+            try {
+                // Overwrite the entries we already have, then adjust the size.
+                iterator it_list        = list.begin();
+                const_iterator it_other = other.list.begin();
+                for (; (it_list != list.end()) && (it_other != other.list.end()); ++it_list, ++it_other) {
+                    *it_list = *it_other;
+                }
+                if (it_list != list.end()) {
+                    list.erase(it_list, list.end());
+                } else {
+                    list.insert(list.end(), it_other, other.list.end());
+                }
+#if __cplusplus >= 201703L
+                // Detach the nodes of the table, so that we can recycle them.
+                std::vector<typename table_t::node_type> nodes;
+                nodes.reserve(table.size());
+                while (!table.empty()) {
+                    nodes.push_back(table.extract(table.begin()));
+                }
+#else
+                table.clear();
+#endif
+                entry_remap_t remap(other.list, list);
+                for (table_const_iterator it_table = other.table.begin(); it_table != other.table.end(); ++it_table) {
+#if __cplusplus >= 201703L
+                    if (!nodes.empty()) {
+                        nodes.back().key()    = it_table->first;
+                        nodes.back().mapped() = remap(*it_table->second);
+                        table.insert(table.end(), std::move(nodes.back()));
+                        nodes.pop_back();
+                        continue;
+                    }
+#endif
+                    table.emplace_hint(table.end(), it_table->first, remap(*it_table->second));
+                }
+            } catch (...) {
+                // The overwritten nodes no longer match the table.
+                table.clear();
+                list.clear();
+                throw;
             }
         }
         return *this;
@@ -249,10 +721,214 @@ private:
     using table_t              = std::map<Key, iterator>;
     using table_iterator       = typename table_t::iterator;
     using table_const_iterator = typename table_t::const_iterator;
+
+    /// @brief The number of elements processed by each parallel task.
+    static constexpr std::size_t parallel_grain = 4096;
+
+    /// @brief The size of the blocks used when serializing raw entries.
+    static constexpr std::size_t serial_block = 65536;
+
+    /// @brief Splits the list into chunks of `parallel_grain` elements.
+    /// @return the iterators to the beginning of each chunk, followed by the
+    /// end of the list.
+    /// @details The list has no positional index, so this is a serial walk
+    /// over all the elements, which only follows the links. It runs on the
+    /// calling thread before the tasks are spread, and it is the part of the
+    /// parallel algorithms which does not scale with the number of threads.
+    auto chunk_bounds() -> std::vector<iterator>
+    {
+        std::vector<iterator> bounds;
+        bounds.reserve((list.size() / parallel_grain) + 2);
+        iterator it = list.begin();
+        for (std::size_t position = 0; position < list.size(); position += parallel_grain) {
+            bounds.push_back(it);
+            std::advance(it, std::min<std::size_t>(parallel_grain, list.size() - position));
+        }
+        bounds.push_back(list.end());
+        return bounds;
+    }
+
+    /// @brief Splits the list into chunks of `parallel_grain` elements.
+    /// @return the iterators to the beginning of each chunk, followed by the
+    /// end of the list.
+    /// @details As the non-constant version, a serial walk over all the elements.
+    auto chunk_bounds() const -> std::vector<const_iterator>
+    {
+        std::vector<const_iterator> bounds;
+        bounds.reserve((list.size() / parallel_grain) + 2);
+        const_iterator it = list.begin();
+        for (std::size_t position = 0; position < list.size(); position += parallel_grain) {
+            bounds.push_back(it);
+            std::advance(it, std::min<std::size_t>(parallel_grain, list.size() - position));
+        }
+        bounds.push_back(list.end());
+        return bounds;
+    }
+
+    /// @brief The header of the binary format.
+    struct serial_header_t {
+        /// @brief The magic number, `OMAP`.
+        char magic[4];
+        /// @brief The version of the format.
+        std::uint32_t version;
+        /// @brief The value `0x01020304`, as written by the machine.
+        std::uint32_t byte_order;
+        /// @brief The size of the raw keys, or zero.
+        std::uint32_t key_size;
+        /// @brief The size of the raw values, or zero.
+        std::uint32_t value_size;
+        /// @brief Keeps the count aligned.
+        std::uint32_t reserved;
+        /// @brief The number of entries.
+        std::uint64_t count;
+    };
+
+    /// @brief Builds the header of the binary format, for this map.
+    /// @param count the number of entries.
+    /// @return the header.
+    static auto make_serial_header(std::uint64_t count) -> serial_header_t
+    {
+        serial_header_t header;
+        std::memcpy(header.magic, "OMAP", sizeof(header.magic));
+        header.version    = 1;
+        header.byte_order = 0x01020304;
+        header.key_size   = is_raw_codec<Key>::value ? static_cast<std::uint32_t>(sizeof(Key)) : 0;
+        header.value_size = is_raw_codec<Value>::value ? static_cast<std::uint32_t>(sizeof(Value)) : 0;
+        header.reserved   = 0;
+        header.count      = count;
+        return header;
+    }
+
+    /// @brief Writes the entries one by one, using their codecs.
+    void save_entries(std::ostream &stream, std::false_type) const
+    {
+        for (const_iterator it = list.begin(); it != list.end(); ++it) {
+            codec_t<Key>::encode(stream, it->first);
+            codec_t<Value>::encode(stream, it->second);
+        }
+    }
+
+    /// @brief Writes the entries in blocks, copying their object representation.
+    void save_entries(std::ostream &stream, std::true_type) const
+    {
+        const std::size_t entry_size = sizeof(Key) + sizeof(Value);
+        std::vector<char> buffer(std::max<std::size_t>(serial_block / entry_size, 1) * entry_size);
+        std::size_t used = 0;
+        for (const_iterator it = list.begin(); it != list.end(); ++it) {
+            std::memcpy(&buffer[used], &it->first, sizeof(Key));
+            std::memcpy(&buffer[used + sizeof(Key)], &it->second, sizeof(Value));
+            used += entry_size;
+            if (used == buffer.size()) {
+                detail::write_bytes(stream, buffer.data(), used);
+                used = 0;
+            }
+        }
+        detail::write_bytes(stream, buffer.data(), used);
+    }
+
+    /// @brief Reads the entries one by one, using their codecs.
+    void load_entries(std::istream &stream, std::uint64_t count, std::vector<iterator> &entries, std::false_type)
+    {
+        for (std::uint64_t index = 0; index < count; ++index) {
+            Key key;
+            Value value;
+            codec_t<Key>::decode(stream, key);
+            codec_t<Value>::decode(stream, value);
+            entries.push_back(list.emplace(list.end(), std::move(key), std::move(value)));
+        }
+    }
+
+    /// @brief Reads the entries in blocks, copying their object representation.
+    void load_entries(std::istream &stream, std::uint64_t count, std::vector<iterator> &entries, std::true_type)
+    {
+        const std::size_t entry_size = sizeof(Key) + sizeof(Value);
+        std::vector<char> buffer(std::max<std::size_t>(serial_block / entry_size, 1) * entry_size);
+        while (count > 0) {
+            const auto block =
+                static_cast<std::size_t>(std::min<std::uint64_t>(count, buffer.size() / entry_size));
+            detail::read_bytes(stream, buffer.data(), block * entry_size);
+            for (std::size_t index = 0; index < block; ++index) {
+                Key key;
+                Value value;
+                std::memcpy(&key, &buffer[index * entry_size], sizeof(Key));
+                std::memcpy(&value, &buffer[(index * entry_size) + sizeof(Key)], sizeof(Value));
+                entries.push_back(list.emplace(list.end(), key, value));
+            }
+            count -= block;
+        }
+    }
+
+    /// @brief Associates the entries of a source list with the entries of its
+    /// element-wise copy, so that the table can be rebuilt without searching
+    /// the keys. It uses a flat open-addressing table indexed by address.
+    class entry_remap_t
+    {
+    public:
+        /// @brief Builds the association between the two lists.
+        /// @param source the list that has been copied.
+        /// @param copy the element-wise copy of the source list.
+        entry_remap_t(const list_t &source, list_t &copy)
+            : mask()
+            , slots()
+        {
+            std::size_t capacity = 16;
+            while (capacity < (source.size() * 2)) {
+                capacity <<= 1U;
+            }
+            mask = capacity - 1;
+            slots.assign(capacity, slot_t(nullptr, copy.end()));
+            iterator it_copy = copy.begin();
+            for (const_iterator it_source = source.begin(); it_source != source.end(); ++it_source, ++it_copy) {
+                std::size_t index = this->hash(&*it_source);
+                while (slots[index].first != nullptr) {
+                    index = (index + 1) & mask;
+                }
+                slots[index] = slot_t(&*it_source, it_copy);
+            }
+        }
+
+        /// @brief Returns the copy of the given entry of the source list.
+        /// @param entry an entry of the source list.
+        /// @return the iterator to the corresponding entry of the copy.
+        auto operator()(const list_entry_t &entry) const -> iterator
+        {
+            std::size_t index = this->hash(&entry);
+            while (slots[index].first != &entry) {
+                index = (index + 1) & mask;
+            }
+            return slots[index].second;
+        }
+
+    private:
+        /// @brief A slot of the table, with the source address and the copy.
+        using slot_t = std::pair<const list_entry_t *, iterator>;
+
+        /// @brief Computes the slot of the given address.
+        /// @param address the address of the source entry.
+        /// @return the index of the first slot to probe.
+        auto hash(const list_entry_t *address) const -> std::size_t
+        {
+            auto value = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(address));
+            value      = (value >> 4U) * 0x9E3779B97F4A7C15ULL;
+            return static_cast<std::size_t>(value >> 32U) & mask;
+        }
+
+        /// @brief The mask used to wrap the indices around the table.
+        std::size_t mask;
+        /// @brief The slots of the table.
+        std::vector<slot_t> slots;
+    };
+
     /// @brief The list containing the actual data.
     list_t list;
     /// @brief A table for easy access to the data by using a key.
     table_t table;
 };
 
+template <typename Key, typename Value>
+constexpr std::size_t ordered_map_t<Key, Value>::parallel_grain;
+
+template <typename Key, typename Value>
+constexpr std::size_t ordered_map_t<Key, Value>::serial_block;
+
 } // namespace ordered_map
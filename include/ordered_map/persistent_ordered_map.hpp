@@ -0,0 +1,585 @@
+/// @file persistent_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A persistent (immutable) version of the ordered map.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace ordered_map
+{
+
+/// @brief This namespace contains the implementation details.
+namespace detail
+{
+
+/// @brief Returns a new, never used before, identifier for a transient edit.
+/// @return the identifier, which is always different from zero.
+inline auto next_edit_id() -> std::uint64_t
+{
+    static std::atomic<std::uint64_t> counter(0);
+    return ++counter;
+}
+
+/// @brief A node of a persistent AVL tree.
+/// @tparam K the type of the key.
+/// @tparam V the type of the value.
+template <typename K, typename V>
+struct avl_node_t {
+    /// @brief The pointer to a node, nodes are shared between versions.
+    using ptr_t = std::shared_ptr<avl_node_t>;
+
+    /// @brief The key of the node.
+    K key;
+    /// @brief The value of the node.
+    V value;
+    /// @brief The left subtree.
+    ptr_t left;
+    /// @brief The right subtree.
+    ptr_t right;
+    /// @brief The height of the subtree rooted in this node.
+    int height;
+    /// @brief The number of nodes of the subtree rooted in this node.
+    std::size_t size;
+    /// @brief The transient edit which owns the node, zero if immutable.
+    std::uint64_t edit;
+};
+
+/// @brief Functions operating on a persistent AVL tree, with path copying.
+/// @details Each modification returns a new root, and copies only the nodes
+/// along the modified path. Nodes owned by the given (non-zero) edit are
+/// instead modified in place, which is used for batching modifications.
+/// @tparam K the type of the key.
+/// @tparam V the type of the value.
+template <typename K, typename V>
+class avl_t
+{
+public:
+    /// @brief The type of a node.
+    using node_t = avl_node_t<K, V>;
+    /// @brief The pointer to a node.
+    using ptr_t  = typename node_t::ptr_t;
+
+    /// @brief Returns the height of the given subtree.
+    /// @param node the root of the subtree.
+    /// @return the height of the subtree.
+    static auto height(const ptr_t &node) -> int { return node ? node->height : 0; }
+
+    /// @brief Returns the number of nodes of the given subtree.
+    /// @param node the root of the subtree.
+    /// @return the number of nodes.
+    static auto size(const ptr_t &node) -> std::size_t { return node ? node->size : 0; }
+
+    /// @brief Searches the node with the given key.
+    /// @param node the root of the tree.
+    /// @param key the key to search.
+    /// @return the node, or `nullptr` if not found.
+    static auto find(const node_t *node, const K &key) -> const node_t *
+    {
+        while (node != nullptr) {
+            if (key < node->key) {
+                node = node->left.get();
+            } else if (node->key < key) {
+                node = node->right.get();
+            } else {
+                return node;
+            }
+        }
+        return nullptr;
+    }
+
+    /// @brief Inserts or updates the given key.
+    /// @param node the root of the tree.
+    /// @param key the key to insert.
+    /// @param value the value to associate with the key.
+    /// @param edit the transient edit, or zero.
+    /// @param inserted set to true if the key was not present.
+    /// @return the new root of the tree.
+    static auto insert(const ptr_t &node, const K &key, const V &value, std::uint64_t edit, bool &inserted) -> ptr_t
+    {
+        if (!node) {
+            inserted = true;
+            return avl_t::make(key, value, nullptr, nullptr, edit);
+        }
+        if (key < node->key) {
+            return avl_t::balance(
+                avl_t::relink(node, avl_t::insert(node->left, key, value, edit, inserted), node->right, edit), edit);
+        }
+        if (node->key < key) {
+            return avl_t::balance(
+                avl_t::relink(node, node->left, avl_t::insert(node->right, key, value, edit, inserted), edit), edit);
+        }
+        inserted    = false;
+        ptr_t copy  = avl_t::editable(node, edit);
+        copy->value = value;
+        return copy;
+    }
+
+    /// @brief Removes the given key.
+    /// @param node the root of the tree.
+    /// @param key the key to remove.
+    /// @param edit the transient edit, or zero.
+    /// @param erased set to true if the key was present.
+    /// @return the new root of the tree.
+    static auto erase(const ptr_t &node, const K &key, std::uint64_t edit, bool &erased) -> ptr_t
+    {
+        if (!node) {
+            erased = false;
+            return node;
+        }
+        if (key < node->key) {
+            ptr_t left = avl_t::erase(node->left, key, edit, erased);
+            return erased ? avl_t::balance(avl_t::relink(node, left, node->right, edit), edit) : node;
+        }
+        if (node->key < key) {
+            ptr_t right = avl_t::erase(node->right, key, edit, erased);
+            return erased ? avl_t::balance(avl_t::relink(node, node->left, right, edit), edit) : node;
+        }
+        erased = true;
+        if (!node->left) {
+            return node->right;
+        }
+        if (!node->right) {
+            return node->left;
+        }
+        // Replace the node with the smallest node of the right subtree.
+        ptr_t minimum;
+        ptr_t right = avl_t::erase_min(node->right, edit, minimum);
+        return avl_t::balance(avl_t::make(minimum->key, minimum->value, node->left, right, edit), edit);
+    }
+
+    /// @brief Returns the path to the node in the given position.
+    /// @param node the root of the tree.
+    /// @param position the in-order position of the node.
+    /// @param path the stack used by the iterators, it receives the ancestors
+    /// in which the path turns left and, finally, the node itself.
+    static void path_to(const node_t *node, std::size_t position, std::vector<const node_t *> &path)
+    {
+        while (node != nullptr) {
+            std::size_t left_size = avl_t::size(node->left);
+            if (position < left_size) {
+                path.push_back(node);
+                node = node->left.get();
+            } else if (position > left_size) {
+                position -= left_size + 1;
+                node = node->right.get();
+            } else {
+                path.push_back(node);
+                return;
+            }
+        }
+        path.clear();
+    }
+
+    /// @brief Returns the path to the node with the given key.
+    /// @param node the root of the tree.
+    /// @param key the key of the node.
+    /// @param path the stack used by the iterators (see `path_to`).
+    static void path_to_key(const node_t *node, const K &key, std::vector<const node_t *> &path)
+    {
+        while (node != nullptr) {
+            if (key < node->key) {
+                path.push_back(node);
+                node = node->left.get();
+            } else if (node->key < key) {
+                node = node->right.get();
+            } else {
+                path.push_back(node);
+                return;
+            }
+        }
+        path.clear();
+    }
+
+    /// @brief Pushes the given node and all its left descendants.
+    /// @param node the root of the subtree.
+    /// @param path the stack used by the iterators.
+    static void push_left(const node_t *node, std::vector<const node_t *> &path)
+    {
+        for (; node != nullptr; node = node->left.get()) {
+            path.push_back(node);
+        }
+    }
+
+private:
+    /// @brief Creates a new node.
+    static auto make(const K &key, const V &value, ptr_t left, ptr_t right, std::uint64_t edit) -> ptr_t
+    {
+        ptr_t node(new node_t{key, value, std::move(left), std::move(right), 0, 0, edit});
+        avl_t::update(*node);
+        return node;
+    }
+
+    /// @brief Updates the height and the size of the node.
+    static void update(node_t &node)
+    {
+        int lh      = avl_t::height(node.left);
+        int rh      = avl_t::height(node.right);
+        node.height = ((lh > rh) ? lh : rh) + 1;
+        node.size   = avl_t::size(node.left) + avl_t::size(node.right) + 1;
+    }
+
+    /// @brief Returns a node which can be modified by the given edit.
+    static auto editable(const ptr_t &node, std::uint64_t edit) -> ptr_t
+    {
+        if ((edit != 0) && (node->edit == edit)) {
+            return node;
+        }
+        return ptr_t(new node_t{node->key, node->value, node->left, node->right, node->height, node->size, edit});
+    }
+
+    /// @brief Returns a version of the node with the given children.
+    static auto relink(const ptr_t &node, ptr_t left, ptr_t right, std::uint64_t edit) -> ptr_t
+    {
+        // Nodes owned by the edit must be updated anyway, since their
+        // children might have been modified in place.
+        if ((node->left == left) && (node->right == right) && ((edit == 0) || (node->edit != edit))) {
+            return node;
+        }
+        ptr_t copy  = avl_t::editable(node, edit);
+        copy->left  = std::move(left);
+        copy->right = std::move(right);
+        avl_t::update(*copy);
+        return copy;
+    }
+
+    /// @brief Rotates the subtree to the right.
+    static auto rotate_right(const ptr_t &node, std::uint64_t edit) -> ptr_t
+    {
+        ptr_t left = node->left;
+        return avl_t::relink(left, left->left, avl_t::relink(node, left->right, node->right, edit), edit);
+    }
+
+    /// @brief Rotates the subtree to the left.
+    static auto rotate_left(const ptr_t &node, std::uint64_t edit) -> ptr_t
+    {
+        ptr_t right = node->right;
+        return avl_t::relink(right, avl_t::relink(node, node->left, right->left, edit), right->right, edit);
+    }
+
+    /// @brief Restores the AVL property of the subtree.
+    static auto balance(const ptr_t &node, std::uint64_t edit) -> ptr_t
+    {
+        int factor = avl_t::height(node->left) - avl_t::height(node->right);
+        if (factor > 1) {
+            ptr_t current = node;
+            if (avl_t::height(node->left->left) < avl_t::height(node->left->right)) {
+                current = avl_t::relink(node, avl_t::rotate_left(node->left, edit), node->right, edit);
+            }
+            return avl_t::rotate_right(current, edit);
+        }
+        if (factor < -1) {
+            ptr_t current = node;
+            if (avl_t::height(node->right->right) < avl_t::height(node->right->left)) {
+                current = avl_t::relink(node, node->left, avl_t::rotate_right(node->right, edit), edit);
+            }
+            return avl_t::rotate_left(current, edit);
+        }
+        return node;
+    }
+
+    /// @brief Removes the smallest node of the subtree.
+    static auto erase_min(const ptr_t &node, std::uint64_t edit, ptr_t &minimum) -> ptr_t
+    {
+        if (!node->left) {
+            minimum = node;
+            return node->right;
+        }
+        ptr_t left = avl_t::erase_min(node->left, edit, minimum);
+        return avl_t::balance(avl_t::relink(node, left, node->right, edit), edit);
+    }
+};
+
+} // namespace detail
+
+/// @brief A persistent ordered map, where each modification creates a new
+/// version of the map, which shares almost all its structure with the
+/// previous one.
+/// @details The map uses two persistent AVL trees: the first associates each
+/// key with a sequence number, the second associates each sequence number
+/// with the `<key,value>` pair. Sequence numbers are assigned in increasing
+/// order, thus, the second tree follows the insertion order. Both `set` and
+/// `erase` take O(log n), and copy only O(log n) nodes. For bulk updates, use
+/// a `transient_t`, which modifies in place the nodes it has already copied.
+/// @tparam Key the type of the key, it must be comparable with `operator<`.
+/// @tparam Value the value stored inside the map.
+template <typename Key, typename Value>
+class persistent_ordered_map_t
+{
+private:
+    /// @brief The tree associating each key with its sequence number.
+    using key_tree_t = detail::avl_t<Key, std::uint64_t>;
+    /// @brief The tree associating each sequence number with its entry.
+    using seq_tree_t = detail::avl_t<std::uint64_t, std::pair<Key, Value>>;
+
+public:
+    /// @brief This stores the key->value association.
+    using list_entry_t = std::pair<Key, Value>;
+
+    /// @brief Constant iterator for the map, following the insertion order.
+    /// @details The iterator is valid as long as the version it comes from.
+    class const_iterator
+    {
+    public:
+        /// @brief Type of the iterated element.
+        using value_type        = list_entry_t;
+        /// @brief Type of the distance between iterators.
+        using difference_type   = std::ptrdiff_t;
+        /// @brief Type of the pointer to the element.
+        using pointer           = const list_entry_t *;
+        /// @brief Type of the reference to the element.
+        using reference         = const list_entry_t &;
+        /// @brief Category of the iterator.
+        using iterator_category = std::forward_iterator_tag;
+
+        /// @brief Creates an end iterator.
+        const_iterator()
+            : path()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Returns the current element.
+        /// @return a reference to the element.
+        auto operator*() const -> reference { return path.back()->value; }
+
+        /// @brief Returns the current element.
+        /// @return a pointer to the element.
+        auto operator->() const -> pointer { return &path.back()->value; }
+
+        /// @brief Moves to the next element, in insertion order.
+        /// @return a reference to the iterator.
+        auto operator++() -> const_iterator &
+        {
+            const typename seq_tree_t::node_t *node = path.back();
+            path.pop_back();
+            seq_tree_t::push_left(node->right.get(), path);
+            return *this;
+        }
+
+        /// @brief Moves to the next element, in insertion order.
+        /// @return a copy of the iterator before moving.
+        auto operator++(int) -> const_iterator
+        {
+            const_iterator previous(*this);
+            ++(*this);
+            return previous;
+        }
+
+        /// @brief Checks if the two iterators point to the same element.
+        /// @param other the other iterator.
+        /// @return true if they point to the same element.
+        auto operator==(const const_iterator &other) const -> bool
+        {
+            if (path.empty() || other.path.empty()) {
+                return path.empty() && other.path.empty();
+            }
+            return path.back() == other.path.back();
+        }
+
+        /// @brief Checks if the two iterators point to different elements.
+        /// @param other the other iterator.
+        /// @return true if they point to different elements.
+        auto operator!=(const const_iterator &other) const -> bool { return !(*this == other); }
+
+    private:
+        friend class persistent_ordered_map_t;
+
+        /// @brief The ancestors still to visit, the last one is the current.
+        std::vector<const typename seq_tree_t::node_t *> path;
+    };
+
+    /// @brief A mutable version of the map, used to batch modifications.
+    /// @details The nodes copied by the transient are owned by it, and
+    /// further modifications update them in place. Thus, a batch of updates
+    /// touching the same paths copies them only once. Calling `persistent`
+    /// returns an immutable version, and the following modifications of the
+    /// transient will not affect it. The transient can be moved, but not
+    /// copied: start a new one from `persistent` instead.
+    class transient_t
+    {
+    public:
+        /// @brief Creates a transient starting from the given version.
+        /// @param map the starting version.
+        explicit transient_t(const persistent_ordered_map_t &map)
+            : data(map)
+            , edit(detail::next_edit_id())
+        {
+            // Nothing to do.
+        }
+
+        // A copy would share the edit, and modify the nodes of the original in place.
+        transient_t(const transient_t &)                     = delete;
+        transient_t(transient_t &&)                          = default;
+        auto operator=(const transient_t &) -> transient_t & = delete;
+        auto operator=(transient_t &&) -> transient_t &      = default;
+
+        /// @brief Returns the number of element in the map.
+        /// @return the number of elements.
+        auto size() const -> std::size_t { return data.size(); }
+
+        /// @brief Returns an iterator to the element associated with the given key.
+        /// @param key the key of the element to search for.
+        /// @return an iterator to the element, or the end of the map if not found.
+        /// @details The iterator is invalidated by the next modification.
+        auto find(const Key &key) const -> const_iterator { return data.find(key); }
+
+        /// @brief Sets/updates the `<key,value>` pair inside the map.
+        /// @param key the value identifier.
+        /// @param value the actual value.
+        /// @return a reference to the transient.
+        auto set(const Key &key, const Value &value) -> transient_t &
+        {
+            data.update(key, value, edit);
+            return *this;
+        }
+
+        /// @brief Erases the element associated with the given key.
+        /// @param key the key of the element to remove.
+        /// @return a reference to the transient.
+        auto erase(const Key &key) -> transient_t &
+        {
+            data.remove(key, edit);
+            return *this;
+        }
+
+        /// @brief Returns an immutable version of the current content.
+        /// @return the persistent map.
+        auto persistent() -> persistent_ordered_map_t
+        {
+            // Change the edit, so that the returned nodes are never modified.
+            edit = detail::next_edit_id();
+            return data;
+        }
+
+    private:
+        /// @brief The current content.
+        persistent_ordered_map_t data;
+        /// @brief The edit identifying the nodes owned by this transient.
+        std::uint64_t edit;
+    };
+
+    /// @brief Construct a new, empty, map.
+    persistent_ordered_map_t()
+        : keys()
+        , entries()
+        , next_seq()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t { return seq_tree_t::size(entries); }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty.
+    auto empty() const -> bool { return !entries; }
+
+    /// @brief Returns a const iterator the beginning of the map.
+    /// @return an iterator to the beginning of the map.
+    auto begin() const -> const_iterator
+    {
+        const_iterator it;
+        seq_tree_t::push_left(entries.get(), it.path);
+        return it;
+    }
+
+    /// @brief Returns a const iterator the end of the map.
+    /// @return an iterator to the end of the map.
+    auto end() const -> const_iterator { return const_iterator(); }
+
+    /// @brief Returns an iterator to the element associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or the end of the map if not found.
+    auto find(const Key &key) const -> const_iterator
+    {
+        const_iterator it;
+        const typename key_tree_t::node_t *node = key_tree_t::find(keys.get(), key);
+        if (node != nullptr) {
+            seq_tree_t::path_to_key(entries.get(), node->value, it.path);
+        }
+        return it;
+    }
+
+    /// @brief Returns an iterator to the element in the given position.
+    /// @param position the position of the element to retrieve.
+    /// @return an iterator to the element, or the end of the map if not found.
+    auto at(std::size_t position) const -> const_iterator
+    {
+        const_iterator it;
+        seq_tree_t::path_to(entries.get(), position, it.path);
+        return it;
+    }
+
+    /// @brief Returns a new version with the `<key,value>` pair set/updated.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    /// @return the new version of the map.
+    auto set(const Key &key, const Value &value) const -> persistent_ordered_map_t
+    {
+        persistent_ordered_map_t result(*this);
+        result.update(key, value, 0);
+        return result;
+    }
+
+    /// @brief Returns a new version without the given key.
+    /// @param key the key of the element to remove.
+    /// @return the new version of the map.
+    auto erase(const Key &key) const -> persistent_ordered_map_t
+    {
+        persistent_ordered_map_t result(*this);
+        result.remove(key, 0);
+        return result;
+    }
+
+    /// @brief Creates a transient, for batching modifications.
+    /// @return the transient.
+    auto transient() const -> transient_t { return transient_t(*this); }
+
+private:
+    /// @brief Sets/updates the `<key,value>` pair.
+    void update(const Key &key, const Value &value, std::uint64_t edit)
+    {
+        const typename key_tree_t::node_t *node = key_tree_t::find(keys.get(), key);
+        bool inserted                           = false;
+        if (node != nullptr) {
+            entries = seq_tree_t::insert(entries, node->value, list_entry_t(key, value), edit, inserted);
+        } else {
+            keys    = key_tree_t::insert(keys, key, next_seq, edit, inserted);
+            entries = seq_tree_t::insert(entries, next_seq, list_entry_t(key, value), edit, inserted);
+            ++next_seq;
+        }
+    }
+
+    /// @brief Removes the given key.
+    void remove(const Key &key, std::uint64_t edit)
+    {
+        const typename key_tree_t::node_t *node = key_tree_t::find(keys.get(), key);
+        if (node != nullptr) {
+            bool erased       = false;
+            std::uint64_t seq = node->value;
+            keys              = key_tree_t::erase(keys, key, edit, erased);
+            entries           = seq_tree_t::erase(entries, seq, edit, erased);
+        }
+    }
+
+    /// @brief The tree associating each key with its sequence number.
+    typename key_tree_t::ptr_t keys;
+    /// @brief The tree associating each sequence number with its entry.
+    typename seq_tree_t::ptr_t entries;
+    /// @brief The sequence number of the next inserted key.
+    std::uint64_t next_seq;
+};
+
+} // namespace ordered_map
@@ -0,0 +1,295 @@
+/// @file rcu_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A read-copy-update version of the ordered map, for read-mostly data.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_map/ordered_map.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace ordered_map
+{
+
+/// @brief An ordered map where readers never block, and never write to
+/// shared memory.
+/// @details Readers access an immutable version of the map, obtained by
+/// loading an atomic pointer. Writers are serialized by a mutex: they copy
+/// the current version, apply a batch of modifications and publish the new
+/// version atomically. Old versions are reclaimed with an epoch-based scheme:
+/// each registered reader owns a slot where it announces the epoch in which
+/// it started reading, and a version is deleted only when no reader could
+/// still be looking at it.
+/// @tparam Key the type of the key.
+/// @tparam Value the value stored inside the map.
+template <typename Key, typename Value>
+class rcu_ordered_map_t
+{
+public:
+    /// @brief The type of an immutable version of the map.
+    using map_t = ordered_map_t<Key, Value>;
+
+    /// @brief Gives access to a version of the map, for as long as it lives.
+    class read_guard_t
+    {
+    public:
+        /// @brief Move constructor.
+        /// @param other the guard to move.
+        read_guard_t(read_guard_t &&other) noexcept
+            : slot(other.slot)
+            , map(other.map)
+        {
+            other.slot = nullptr;
+        }
+
+        /// @brief Ends the read-side critical section.
+        ~read_guard_t()
+        {
+            if (slot != nullptr) {
+                slot->store(0, std::memory_order_release);
+            }
+        }
+
+        /// @brief Returns the version of the map.
+        /// @return a constant reference to the map.
+        auto operator*() const -> const map_t & { return *map; }
+
+        /// @brief Returns the version of the map.
+        /// @return a constant pointer to the map.
+        auto operator->() const -> const map_t * { return map; }
+
+        read_guard_t(const read_guard_t &)                     = delete;
+        auto operator=(const read_guard_t &) -> read_guard_t & = delete;
+        auto operator=(read_guard_t &&) -> read_guard_t &      = delete;
+
+    private:
+        friend class rcu_ordered_map_t;
+
+        /// @brief Starts the read-side critical section.
+        read_guard_t(std::atomic<std::uint64_t> *_slot, const map_t *_map)
+            : slot(_slot)
+            , map(_map)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief The slot of the reader.
+        std::atomic<std::uint64_t> *slot;
+        /// @brief The version being read.
+        const map_t *map;
+    };
+
+    /// @brief A registered reader, it must be used by one thread at a time.
+    class reader_t
+    {
+    public:
+        /// @brief Move constructor.
+        /// @param other the reader to move.
+        reader_t(reader_t &&other) noexcept
+            : owner(other.owner)
+            , index(other.index)
+        {
+            other.owner = nullptr;
+        }
+
+        /// @brief Releases the slot of the reader.
+        ~reader_t()
+        {
+            if (owner != nullptr) {
+                owner->slots[index].used.store(false, std::memory_order_release);
+            }
+        }
+
+        /// @brief Starts reading the current version of the map.
+        /// @details Read sections of the same reader must not be nested.
+        /// @return the guard giving access to the version.
+        auto read() const -> read_guard_t
+        {
+            std::atomic<std::uint64_t> &slot = owner->slots[index].epoch;
+            // Announce the epoch before loading the pointer, so that writers
+            // publishing after this point will not delete what we load.
+            slot.store(owner->epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            return read_guard_t(&slot, owner->current.load(std::memory_order_seq_cst));
+        }
+
+        reader_t(const reader_t &)                     = delete;
+        auto operator=(const reader_t &) -> reader_t & = delete;
+        auto operator=(reader_t &&) -> reader_t &      = delete;
+
+    private:
+        friend class rcu_ordered_map_t;
+
+        /// @brief Creates the reader.
+        reader_t(rcu_ordered_map_t *_owner, std::size_t _index)
+            : owner(_owner)
+            , index(_index)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief The map being read.
+        rcu_ordered_map_t *owner;
+        /// @brief The index of the slot owned by the reader.
+        std::size_t index;
+    };
+
+    /// @brief Construct a new, empty, map.
+    /// @param max_readers the maximum number of readers registered at once.
+    explicit rcu_ordered_map_t(std::size_t max_readers = 128)
+        : current(new map_t())
+        , epoch(1)
+        , slots(max_readers)
+        , retired()
+        , writer()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Destroys the map, no reader must be active.
+    ~rcu_ordered_map_t()
+    {
+        for (const retired_t &version : retired) {
+            delete version.second;
+        }
+        delete current.load();
+    }
+
+    rcu_ordered_map_t(const rcu_ordered_map_t &)                     = delete;
+    rcu_ordered_map_t(rcu_ordered_map_t &&)                          = delete;
+    auto operator=(const rcu_ordered_map_t &) -> rcu_ordered_map_t & = delete;
+    auto operator=(rcu_ordered_map_t &&) -> rcu_ordered_map_t &      = delete;
+
+    /// @brief Registers a new reader.
+    /// @return the reader.
+    /// @throws std::runtime_error if all the slots are in use.
+    auto make_reader() -> reader_t
+    {
+        for (std::size_t index = 0; index < slots.size(); ++index) {
+            bool expected = false;
+            if (slots[index].used.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                return reader_t(this, index);
+            }
+        }
+        throw std::runtime_error("rcu_ordered_map_t: too many readers");
+    }
+
+    /// @brief Applies a batch of modifications, and publishes the result.
+    /// @param fun the function applying the modifications, it is called as
+    /// `fun(map_t &)` on a private copy of the current version.
+    template <typename Function>
+    void update(Function fun)
+    {
+        std::lock_guard<std::mutex> lock(writer);
+        map_t *next = new map_t(*current.load(std::memory_order_relaxed));
+        try {
+            fun(*next);
+        } catch (...) {
+            delete next;
+            throw;
+        }
+        this->publish(next);
+    }
+
+    /// @brief Sets/updates a single `<key,value>` pair, and publishes the result.
+    /// @details Each call copies the map, use `update` to batch modifications.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    void set(const Key &key, const Value &value)
+    {
+        this->update([&key, &value](map_t &map) { map.set(key, value); });
+    }
+
+    /// @brief Erases a single key, and publishes the result.
+    /// @details Each call copies the map, use `update` to batch modifications.
+    /// @param key the key of the element to remove.
+    void erase(const Key &key)
+    {
+        this->update([&key](map_t &map) { map.erase(key); });
+    }
+
+    /// @brief Deletes the old versions which can no longer be read.
+    /// @return the number of versions still waiting to be deleted.
+    auto reclaim() -> std::size_t
+    {
+        std::lock_guard<std::mutex> lock(writer);
+        this->collect();
+        return retired.size();
+    }
+
+private:
+    /// @brief A version waiting to be deleted, with the epoch of its retirement.
+    using retired_t = std::pair<std::uint64_t, const map_t *>;
+
+    /// @brief The slot of a reader, kept on its own cache line.
+    struct slot_t {
+        /// @brief Construct a new free slot.
+        slot_t()
+            : epoch(0)
+            , used(false)
+            , padding()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief The epoch in which the reader started, zero when not reading.
+        std::atomic<std::uint64_t> epoch;
+        /// @brief If the slot is owned by a reader.
+        std::atomic<bool> used;
+        /// @brief Keeps adjacent slots on different cache lines.
+        char padding[64];
+    };
+
+    /// @brief Publishes the new version, and retires the old one.
+    void publish(const map_t *next)
+    {
+        const map_t *previous = current.exchange(next, std::memory_order_seq_cst);
+        // Readers which might have loaded the previous version announced an
+        // epoch lower or equal to the one we are closing.
+        retired.push_back(retired_t(epoch.fetch_add(1, std::memory_order_seq_cst), previous));
+        this->collect();
+    }
+
+    /// @brief Deletes the retired versions no reader can see.
+    void collect()
+    {
+        std::uint64_t oldest = std::numeric_limits<std::uint64_t>::max();
+        for (const slot_t &slot : slots) {
+            std::uint64_t value = slot.epoch.load(std::memory_order_seq_cst);
+            if ((value != 0) && (value < oldest)) {
+                oldest = value;
+            }
+        }
+        std::size_t kept = 0;
+        for (std::size_t index = 0; index < retired.size(); ++index) {
+            if (retired[index].first < oldest) {
+                delete retired[index].second;
+            } else {
+                retired[kept++] = retired[index];
+            }
+        }
+        retired.resize(kept);
+    }
+
+    /// @brief The current version.
+    std::atomic<const map_t *> current;
+    /// @brief The global epoch.
+    std::atomic<std::uint64_t> epoch;
+    /// @brief The slots of the readers.
+    std::vector<slot_t> slots;
+    /// @brief The versions waiting to be deleted.
+    std::vector<retired_t> retired;
+    /// @brief Serializes the writers.
+    std::mutex writer;
+};
+
+} // namespace ordered_map
@@ -0,0 +1,321 @@
+/// @file seqlock_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A single-writer version of the ordered map, with optimistic readers.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace ordered_map
+{
+
+/// @brief An ordered map with a single writer thread and many reader threads,
+/// where readers take no lock and write no shared memory.
+/// @details The content is protected by a sequence lock: the writer makes the
+/// sequence odd while modifying the map, and even again when done. Readers
+/// copy out what they need and retry if the sequence changed in the meantime.
+/// For this reason, the storage never moves: the map has a fixed capacity,
+/// the entries are kept in insertion order inside a flat array, and they are
+/// indexed by an open-addressing hash table. Both keys and values must be
+/// trivially copyable, and are stored as relaxed atomic words, so that the
+/// optimistic reads are free from data races. Erasing an element compacts the
+/// entries, which takes linear time on the writer side.
+/// @tparam Key the type of the key, it must be trivially copyable.
+/// @tparam Value the value stored inside the map, it must be trivially copyable.
+/// @tparam Hash the hash function used to index the keys.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class seqlock_ordered_map_t
+{
+    static_assert(std::is_trivially_copyable<Key>::value, "The key must be trivially copyable.");
+    static_assert(std::is_trivially_copyable<Value>::value, "The value must be trivially copyable.");
+
+public:
+    /// @brief Construct a new, empty, map.
+    /// @param _capacity the maximum number of elements.
+    explicit seqlock_ordered_map_t(std::size_t _capacity)
+        : capacity(_capacity)
+        , mask()
+        , sequence(0)
+        , count(0)
+        , entries(_capacity * entry_words)
+        , slots()
+        , hasher()
+    {
+        std::size_t table_size = 16;
+        while (table_size < (capacity * 2)) {
+            table_size <<= 1U;
+        }
+        mask = table_size - 1;
+        slots = std::vector<std::atomic<std::size_t>>(table_size);
+    }
+
+    /// @brief Returns the maximum number of elements.
+    /// @return the capacity of the map.
+    auto max_size() const -> std::size_t { return capacity; }
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t { return count.load(std::memory_order_acquire); }
+
+    /// @brief Copies the value associated with the given key (any thread).
+    /// @param key the key of the element to search for.
+    /// @param value where the value is copied, if found.
+    /// @return true if the key was found, false otherwise.
+    auto find(const Key &key, Value &value) const -> bool
+    {
+        bool found = false;
+        this->read([this, &key, &value, &found]() {
+            std::size_t index = 0;
+            found             = this->lookup(key, index, nullptr);
+            if (found) {
+                this->load_value(index, value);
+            }
+        });
+        return found;
+    }
+
+    /// @brief Copies the element in the given position (any thread).
+    /// @param position the position of the element to retrieve.
+    /// @param key where the key is copied, if found.
+    /// @param value where the value is copied, if found.
+    /// @return true if the position is valid, false otherwise.
+    auto at(std::size_t position, Key &key, Value &value) const -> bool
+    {
+        bool found = false;
+        this->read([this, position, &key, &value, &found]() {
+            found = position < count.load(std::memory_order_relaxed);
+            if (found) {
+                this->load_key(position, key);
+                this->load_value(position, value);
+            }
+        });
+        return found;
+    }
+
+    /// @brief Sets/updates the `<key,value>` pair inside the map (writer only).
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    /// @return true if the key was inserted, false if it was updated.
+    /// @throws std::length_error if the map is full.
+    auto set(const Key &key, const Value &value) -> bool
+    {
+        std::size_t index = 0;
+        std::size_t slot  = 0;
+        if (this->lookup(key, index, &slot)) {
+            this->write_begin();
+            this->store_value(index, value);
+            this->write_end();
+            return false;
+        }
+        std::size_t size = count.load(std::memory_order_relaxed);
+        if (size == capacity) {
+            throw std::length_error("seqlock_ordered_map_t: the map is full");
+        }
+        this->write_begin();
+        this->store_key(size, key);
+        this->store_value(size, value);
+        slots[slot].store(size + 1, std::memory_order_relaxed);
+        count.store(size + 1, std::memory_order_relaxed);
+        this->write_end();
+        return true;
+    }
+
+    /// @brief Erases the element associated with the given key (writer only).
+    /// @param key the key of the element to remove.
+    /// @return true if the element was removed, false otherwise.
+    auto erase(const Key &key) -> bool
+    {
+        std::size_t index = 0;
+        std::size_t slot  = 0;
+        if (!this->lookup(key, index, &slot)) {
+            return false;
+        }
+        std::size_t size = count.load(std::memory_order_relaxed);
+        this->write_begin();
+        // Remove the slot, shifting back the following ones of the cluster.
+        std::size_t hole = slot;
+        for (std::size_t next = (hole + 1) & mask;; next = (next + 1) & mask) {
+            std::size_t entry = slots[next].load(std::memory_order_relaxed);
+            if (entry == 0) {
+                break;
+            }
+            Key other;
+            this->load_key(entry - 1, other);
+            std::size_t home = this->home_of(other);
+            // Move the entry back only if the hole lies on its probe path.
+            if (((next - home) & mask) >= ((next - hole) & mask)) {
+                slots[hole].store(entry, std::memory_order_relaxed);
+                hole = next;
+            }
+        }
+        slots[hole].store(0, std::memory_order_relaxed);
+        // Compact the entries, to keep them in insertion order.
+        for (std::size_t position = index + 1; position < size; ++position) {
+            for (std::size_t word = 0; word < entry_words; ++word) {
+                entries[((position - 1) * entry_words) + word].store(
+                    entries[(position * entry_words) + word].load(std::memory_order_relaxed), std::memory_order_relaxed);
+            }
+        }
+        for (std::atomic<std::size_t> &entry : slots) {
+            std::size_t value = entry.load(std::memory_order_relaxed);
+            if (value > (index + 1)) {
+                entry.store(value - 1, std::memory_order_relaxed);
+            }
+        }
+        count.store(size - 1, std::memory_order_relaxed);
+        this->write_end();
+        return true;
+    }
+
+    /// @brief Clears the content of the map (writer only).
+    void clear()
+    {
+        this->write_begin();
+        for (std::atomic<std::size_t> &entry : slots) {
+            entry.store(0, std::memory_order_relaxed);
+        }
+        count.store(0, std::memory_order_relaxed);
+        this->write_end();
+    }
+
+private:
+    /// @brief The word used to store keys and values.
+    using word_t = std::uint64_t;
+
+    /// @brief The number of words used to store a key.
+    static constexpr std::size_t key_words   = (sizeof(Key) + sizeof(word_t) - 1) / sizeof(word_t);
+    /// @brief The number of words used to store a value.
+    static constexpr std::size_t value_words = (sizeof(Value) + sizeof(word_t) - 1) / sizeof(word_t);
+    /// @brief The number of words used to store an entry.
+    static constexpr std::size_t entry_words = key_words + value_words;
+
+    /// @brief Runs the given reading function until it sees a consistent state.
+    template <typename Function>
+    void read(Function fun) const
+    {
+        for (unsigned attempt = 0;; ++attempt) {
+            std::uint64_t before = sequence.load(std::memory_order_acquire);
+            if ((before & 1U) == 0) {
+                fun();
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (sequence.load(std::memory_order_relaxed) == before) {
+                    return;
+                }
+            }
+            if (attempt > 64) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    /// @brief Marks the beginning of a modification.
+    void write_begin()
+    {
+        sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    /// @brief Marks the end of a modification.
+    void write_end() { sequence.store(sequence.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    /// @brief Returns the first slot to probe for the given key.
+    auto home_of(const Key &key) const -> std::size_t
+    {
+        auto value = static_cast<std::uint64_t>(hasher(key));
+        value      = (value ^ (value >> 31U)) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<std::size_t>(value >> 32U) & mask;
+    }
+
+    /// @brief Searches the given key.
+    /// @param key the key to search.
+    /// @param index receives the position of the entry, if found.
+    /// @param free_slot if not null, receives the slot of the key, or the
+    /// empty slot where it should be inserted.
+    /// @return true if the key was found.
+    auto lookup(const Key &key, std::size_t &index, std::size_t *free_slot) const -> bool
+    {
+        std::size_t slot = this->home_of(key);
+        // The number of probes is bounded, since a reader might see a torn state.
+        for (std::size_t probe = 0; probe <= mask; ++probe, slot = (slot + 1) & mask) {
+            std::size_t entry = slots[slot].load(std::memory_order_relaxed);
+            if ((entry == 0) || (entry > capacity)) {
+                if (free_slot != nullptr) {
+                    *free_slot = slot;
+                }
+                return false;
+            }
+            Key other;
+            this->load_key(entry - 1, other);
+            if (other == key) {
+                index = entry - 1;
+                if (free_slot != nullptr) {
+                    *free_slot = slot;
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// @brief Loads an object from the given words.
+    template <typename T>
+    void load(std::size_t offset, T &object) const
+    {
+        word_t buffer[(sizeof(T) + sizeof(word_t) - 1) / sizeof(word_t)];
+        for (std::size_t word = 0; word < (sizeof(buffer) / sizeof(word_t)); ++word) {
+            buffer[word] = entries[offset + word].load(std::memory_order_relaxed);
+        }
+        std::memcpy(static_cast<void *>(&object), buffer, sizeof(T));
+    }
+
+    /// @brief Stores an object into the given words.
+    template <typename T>
+    void store(std::size_t offset, const T &object)
+    {
+        word_t buffer[(sizeof(T) + sizeof(word_t) - 1) / sizeof(word_t)] = {};
+        std::memcpy(buffer, static_cast<const void *>(&object), sizeof(T));
+        for (std::size_t word = 0; word < (sizeof(buffer) / sizeof(word_t)); ++word) {
+            entries[offset + word].store(buffer[word], std::memory_order_relaxed);
+        }
+    }
+
+    /// @brief Loads the key of the given entry.
+    void load_key(std::size_t index, Key &key) const { this->load(index * entry_words, key); }
+
+    /// @brief Loads the value of the given entry.
+    void load_value(std::size_t index, Value &value) const { this->load((index * entry_words) + key_words, value); }
+
+    /// @brief Stores the key of the given entry.
+    void store_key(std::size_t index, const Key &key) { this->store(index * entry_words, key); }
+
+    /// @brief Stores the value of the given entry.
+    void store_value(std::size_t index, const Value &value) { this->store((index * entry_words) + key_words, value); }
+
+    /// @brief The maximum number of elements.
+    std::size_t capacity;
+    /// @brief The mask used to wrap the indices around the hash table.
+    std::size_t mask;
+    /// @brief The sequence lock, odd while the writer is modifying the map.
+    std::atomic<std::uint64_t> sequence;
+    /// @brief The number of elements.
+    std::atomic<std::size_t> count;
+    /// @brief The keys and values, in insertion order.
+    std::vector<std::atomic<word_t>> entries;
+    /// @brief The hash table, each slot stores the position of an entry plus one.
+    std::vector<std::atomic<std::size_t>> slots;
+    /// @brief The hash function.
+    Hash hasher;
+};
+
+} // namespace ordered_map
@@ -0,0 +1,427 @@
+/// @file shared_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An ordered map living inside a POSIX shared memory segment.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+/// @details This header requires a POSIX system (`shm_open`, `pthread`).
+///
+
+#pragma once
+
+#include "ordered_map/mapped_ordered_map.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ordered_map
+{
+
+/// @brief An ordered map stored inside a named POSIX shared memory segment,
+/// which many processes can attach to, instead of keeping their own copy.
+/// @details Since each process maps the segment at a different address, the
+/// structure uses offsets from the beginning of the segment instead of
+/// pointers. The segment contains:
+///  - a header, with a process-shared mutex protecting the whole map;
+///  - the buckets of a chained hash index;
+///  - a pool of fixed-size nodes, managed by a bump allocator with a free
+///    list, where each node links the previous and the next entry in
+///    insertion order, and the next entry of its bucket.
+///
+/// Keys and values must be trivially copyable (e.g., fixed-size character
+/// arrays instead of strings), keys are compared by their object
+/// representation, and the number of entries is fixed at creation. On Linux,
+/// the mutex is robust: if a process dies while holding it, the next one
+/// acquires it and the map stays usable, although the interrupted operation
+/// may be partially applied.
+/// @tparam Key the type of the key.
+/// @tparam Value the value stored inside the map.
+template <typename Key, typename Value>
+class shared_ordered_map_t
+{
+    static_assert(std::is_trivially_copyable<Key>::value, "the key must be trivially copyable");
+    static_assert(std::is_trivially_copyable<Value>::value, "the value must be trivially copyable");
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "the magic number must be shared without locks");
+
+public:
+    /// @brief Creates a new segment, and attaches to it.
+    /// @param name the name of the segment, starting with a slash.
+    /// @param capacity the maximum number of entries.
+    /// @return the map.
+    /// @throws std::system_error if the segment cannot be created (e.g., it exists).
+    static auto create(const std::string &name, std::size_t capacity) -> shared_ordered_map_t
+    {
+        std::uint64_t buckets = 16;
+        while (buckets < capacity) {
+            buckets <<= 1U;
+        }
+        const std::uint64_t buckets_offset = align(sizeof(header_t));
+        const std::uint64_t heap_offset    = align(buckets_offset + (buckets * sizeof(std::uint64_t)));
+        const std::uint64_t size           = heap_offset + (capacity * node_size());
+        int descriptor                     = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (descriptor < 0) {
+            throw std::system_error(errno, std::generic_category(), "shared_ordered_map_t: cannot create " + name);
+        }
+        if (::ftruncate(descriptor, static_cast<off_t>(size)) != 0) {
+            int error = errno;
+            ::close(descriptor);
+            ::shm_unlink(name.c_str());
+            throw std::system_error(error, std::generic_category(), "shared_ordered_map_t: cannot resize " + name);
+        }
+        shared_ordered_map_t map(descriptor, static_cast<std::size_t>(size), name);
+        // The segment is zero-filled, so the buckets and the lists are empty.
+        header_t *header       = map.header();
+        header->node_size      = node_size();
+        header->buckets_offset = buckets_offset;
+        header->bucket_count   = buckets;
+        header->heap_top       = heap_offset;
+        header->heap_end       = size;
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init(&attributes);
+        pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+#if defined(__linux__)
+        pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+#endif
+        pthread_mutex_init(&header->mutex, &attributes);
+        pthread_mutexattr_destroy(&attributes);
+        // Publish the segment only once the header is complete, since other
+        // processes can open it as soon as it has its size.
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic.store(shared_magic(), std::memory_order_relaxed);
+        return map;
+    }
+
+    /// @brief Attaches to an existing segment.
+    /// @param name the name of the segment.
+    /// @return the map.
+    /// @throws std::system_error if the segment cannot be opened.
+    /// @throws std::runtime_error if the segment does not contain a compatible map.
+    static auto open(const std::string &name) -> shared_ordered_map_t
+    {
+        int descriptor = ::shm_open(name.c_str(), O_RDWR, 0600);
+        if (descriptor < 0) {
+            throw std::system_error(errno, std::generic_category(), "shared_ordered_map_t: cannot open " + name);
+        }
+        struct stat status;
+        if (::fstat(descriptor, &status) != 0) {
+            int error = errno;
+            ::close(descriptor);
+            throw std::system_error(error, std::generic_category(), "shared_ordered_map_t: cannot stat " + name);
+        }
+        const auto size = static_cast<std::size_t>(status.st_size);
+        if (size < sizeof(header_t)) {
+            ::close(descriptor);
+            throw std::runtime_error("shared_ordered_map_t: " + name + " is not a shared map");
+        }
+        shared_ordered_map_t map(descriptor, size, name);
+        const header_t *header    = map.header();
+        const std::uint64_t magic = header->magic.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((magic != shared_magic()) || (header->node_size != node_size()) || (header->heap_end != size)) {
+            throw std::runtime_error("shared_ordered_map_t: " + name + " is not a compatible shared map");
+        }
+        return map;
+    }
+
+    /// @brief Removes the name of the segment, which is freed once all the processes detach.
+    /// @param name the name of the segment.
+    static void remove(const std::string &name) { ::shm_unlink(name.c_str()); }
+
+    /// @brief Move constructor.
+    /// @param other the map to move.
+    shared_ordered_map_t(shared_ordered_map_t &&other) noexcept
+        : base(other.base)
+        , length(other.length)
+    {
+        other.base = nullptr;
+    }
+
+    /// @brief Detaches from the segment.
+    ~shared_ordered_map_t()
+    {
+        if (base != nullptr) {
+            ::munmap(base, length);
+        }
+    }
+
+    shared_ordered_map_t(const shared_ordered_map_t &)                     = delete;
+    auto operator=(const shared_ordered_map_t &) -> shared_ordered_map_t & = delete;
+    auto operator=(shared_ordered_map_t &&) -> shared_ordered_map_t &      = delete;
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t
+    {
+        lock_t lock(this->header());
+        return static_cast<std::size_t>(this->header()->count);
+    }
+
+    /// @brief Returns the maximum number of element in the map.
+    /// @return the capacity.
+    auto capacity() const -> std::size_t
+    {
+        const header_t *header = this->header();
+        return static_cast<std::size_t>((header->heap_end - align(header->buckets_offset +
+                                                                  (header->bucket_count * sizeof(std::uint64_t)))) /
+                                        node_size());
+    }
+
+    /// @brief Sets/updates the `<key,value>` pair inside the map.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    /// @throws std::length_error if the map is full.
+    void set(const Key &key, const Value &value)
+    {
+        header_t *header = this->header();
+        lock_t lock(header);
+        std::uint64_t *bucket = this->bucket(key);
+        std::uint64_t offset  = this->lookup(*bucket, key);
+        if (offset != 0) {
+            this->node(offset)->value = value;
+            return;
+        }
+        offset        = this->allocate();
+        node_t *entry = this->node(offset);
+        entry->key    = key;
+        entry->value  = value;
+        entry->chain  = *bucket;
+        entry->prev   = header->tail;
+        entry->next   = 0;
+        *bucket       = offset;
+        if (header->tail != 0) {
+            this->node(header->tail)->next = offset;
+        } else {
+            header->head = offset;
+        }
+        header->tail = offset;
+        ++header->count;
+    }
+
+    /// @brief Copies the value associated with the given key.
+    /// @param key the key of the element to search for.
+    /// @param value where the value is copied, if found.
+    /// @return true if the key was found, false otherwise.
+    auto find(const Key &key, Value &value) const -> bool
+    {
+        lock_t lock(this->header());
+        std::uint64_t offset = this->lookup(*this->bucket(key), key);
+        if (offset == 0) {
+            return false;
+        }
+        value = this->node(offset)->value;
+        return true;
+    }
+
+    /// @brief Erases the element associated with the given key.
+    /// @param key the key of the element to remove.
+    /// @return true if the element was removed, false otherwise.
+    auto erase(const Key &key) -> bool
+    {
+        header_t *header = this->header();
+        lock_t lock(header);
+        // Search the link pointing to the node inside the bucket.
+        std::uint64_t *link = this->bucket(key);
+        while ((*link != 0) && !this->matches(*link, key)) {
+            link = &this->node(*link)->chain;
+        }
+        if (*link == 0) {
+            return false;
+        }
+        const std::uint64_t offset = *link;
+        node_t *entry              = this->node(offset);
+        *link                      = entry->chain;
+        if (entry->prev != 0) {
+            this->node(entry->prev)->next = entry->next;
+        } else {
+            header->head = entry->next;
+        }
+        if (entry->next != 0) {
+            this->node(entry->next)->prev = entry->prev;
+        } else {
+            header->tail = entry->prev;
+        }
+        entry->next       = header->free_list;
+        header->free_list = offset;
+        --header->count;
+        return true;
+    }
+
+    /// @brief Calls the function on each element, in insertion order, while holding the lock.
+    /// @param fun the function, called as `fun(const Key &, const Value &)`.
+    template <typename Function>
+    void for_each(Function fun) const
+    {
+        lock_t lock(this->header());
+        for (std::uint64_t offset = this->header()->head; offset != 0; offset = this->node(offset)->next) {
+            fun(this->node(offset)->key, this->node(offset)->value);
+        }
+    }
+
+private:
+    /// @brief The header of the segment.
+    struct header_t {
+        /// @brief The magic number, `OMSHARED`, written last by `create`.
+        std::atomic<std::uint64_t> magic;
+        /// @brief The size of a node, to detect incompatible types.
+        std::uint64_t node_size;
+        /// @brief Protects the whole map.
+        pthread_mutex_t mutex;
+        /// @brief The offset of the buckets.
+        std::uint64_t buckets_offset;
+        /// @brief The number of buckets, a power of two.
+        std::uint64_t bucket_count;
+        /// @brief The first node never allocated.
+        std::uint64_t heap_top;
+        /// @brief The end of the segment.
+        std::uint64_t heap_end;
+        /// @brief The first released node.
+        std::uint64_t free_list;
+        /// @brief The first entry, in insertion order.
+        std::uint64_t head;
+        /// @brief The last entry, in insertion order.
+        std::uint64_t tail;
+        /// @brief The number of entries.
+        std::uint64_t count;
+    };
+
+    /// @brief A node, linked by offsets, where zero means none.
+    struct node_t {
+        std::uint64_t prev;  ///< The previous entry, in insertion order.
+        std::uint64_t next;  ///< The next entry, in insertion order, or the next free node.
+        std::uint64_t chain; ///< The next node inside the same bucket.
+        Key key;             ///< The key.
+        Value value;         ///< The value.
+    };
+
+    /// @brief Holds the process-shared mutex.
+    class lock_t
+    {
+    public:
+        /// @brief Acquires the mutex, recovering it if its owner died.
+        explicit lock_t(const header_t *_header)
+            : mutex(const_cast<pthread_mutex_t *>(&_header->mutex))
+        {
+            int result = pthread_mutex_lock(mutex);
+#if defined(__linux__)
+            if (result == EOWNERDEAD) {
+                result = pthread_mutex_consistent(mutex);
+            }
+#endif
+            if (result != 0) {
+                throw std::system_error(result, std::generic_category(), "shared_ordered_map_t: cannot lock");
+            }
+        }
+
+        /// @brief Releases the mutex.
+        ~lock_t() { pthread_mutex_unlock(mutex); }
+
+        lock_t(const lock_t &)                     = delete;
+        auto operator=(const lock_t &) -> lock_t & = delete;
+
+    private:
+        /// @brief The mutex.
+        pthread_mutex_t *mutex;
+    };
+
+    /// @brief Maps the segment, and closes the descriptor.
+    shared_ordered_map_t(int descriptor, std::size_t _length, const std::string &name)
+        : base(nullptr)
+        , length(_length)
+    {
+        void *address = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+        int error     = errno;
+        ::close(descriptor);
+        if (address == MAP_FAILED) {
+            throw std::system_error(error, std::generic_category(), "shared_ordered_map_t: cannot map " + name);
+        }
+        base = static_cast<char *>(address);
+    }
+
+    /// @brief Rounds the offset up to a multiple of the cache line.
+    static auto align(std::uint64_t offset) -> std::uint64_t
+    {
+        return (offset + 63U) & ~static_cast<std::uint64_t>(63U);
+    }
+
+    /// @brief Returns the size of a node, keeping the nodes aligned.
+    static auto node_size() -> std::uint64_t
+    {
+        return ((sizeof(node_t) + alignof(node_t) - 1) / alignof(node_t)) * alignof(node_t);
+    }
+
+    /// @brief Returns the magic number, with the bytes of `OMSHARED`.
+    static auto shared_magic() -> std::uint64_t
+    {
+        std::uint64_t magic = 0;
+        std::memcpy(&magic, "OMSHARED", sizeof(magic));
+        return magic;
+    }
+
+    /// @brief Returns the header.
+    auto header() const -> header_t * { return reinterpret_cast<header_t *>(base); }
+
+    /// @brief Returns the node at the given offset.
+    auto node(std::uint64_t offset) const -> node_t * { return reinterpret_cast<node_t *>(base + offset); }
+
+    /// @brief Returns the bucket of the key.
+    auto bucket(const Key &key) const -> std::uint64_t *
+    {
+        const header_t *header   = this->header();
+        const std::uint64_t hash = detail::mapped_hash(reinterpret_cast<const char *>(&key), sizeof(Key));
+        return reinterpret_cast<std::uint64_t *>(base + header->buckets_offset) + (hash & (header->bucket_count - 1));
+    }
+
+    /// @brief Checks if the node at the given offset contains the key.
+    auto matches(std::uint64_t offset, const Key &key) const -> bool
+    {
+        return std::memcmp(&this->node(offset)->key, &key, sizeof(Key)) == 0;
+    }
+
+    /// @brief Searches the key inside the chain starting at the given node.
+    /// @return the offset of the node, or zero.
+    auto lookup(std::uint64_t offset, const Key &key) const -> std::uint64_t
+    {
+        while ((offset != 0) && !this->matches(offset, key)) {
+            offset = this->node(offset)->chain;
+        }
+        return offset;
+    }
+
+    /// @brief Allocates a node, reusing the released ones first.
+    /// @return the offset of the node.
+    auto allocate() -> std::uint64_t
+    {
+        header_t *header = this->header();
+        if (header->free_list != 0) {
+            const std::uint64_t offset = header->free_list;
+            header->free_list          = this->node(offset)->next;
+            return offset;
+        }
+        if (header->heap_top + node_size() > header->heap_end) {
+            throw std::length_error("shared_ordered_map_t: the map is full");
+        }
+        const std::uint64_t offset = header->heap_top;
+        header->heap_top += node_size();
+        return offset;
+    }
+
+    /// @brief The beginning of the mapping.
+    char *base;
+    /// @brief The size of the mapping.
+    std::size_t length;
+};
+
+} // namespace ordered_map
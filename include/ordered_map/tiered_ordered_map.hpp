@@ -0,0 +1,731 @@
+/// @file tiered_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An ordered map which spills its cold values to a file.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_map/codec.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ordered_map
+{
+
+namespace detail
+{
+
+/// @brief A stream buffer which only counts the characters written to it.
+class counting_buffer_t : public std::streambuf
+{
+public:
+    /// @brief Construct an empty buffer.
+    counting_buffer_t()
+        : count(0)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief The number of characters written.
+    std::size_t count;
+
+protected:
+    /// @brief Counts a single character.
+    auto overflow(int_type character) -> int_type override
+    {
+        if (!traits_type::eq_int_type(character, traits_type::eof())) {
+            ++count;
+        }
+        return traits_type::not_eof(character);
+    }
+
+    /// @brief Counts a sequence of characters.
+    auto xsputn(const char *, std::streamsize size) -> std::streamsize override
+    {
+        count += static_cast<std::size_t>(size);
+        return size;
+    }
+};
+
+/// @brief Returns the size of the value once encoded by its codec.
+template <typename Value>
+auto encoded_size(const Value &value) -> std::size_t
+{
+    counting_buffer_t buffer;
+    std::ostream stream(&buffer);
+    codec_t<Value>::encode(stream, value);
+    return buffer.count;
+}
+
+/// @brief A tournament tree of losers, which repeatedly selects the smallest
+/// head among several sorted sources, with one comparison per level.
+/// @tparam Less the function comparing the heads of two sources, called as
+/// `less(i, j)`, which must treat the exhausted sources as the largest ones.
+template <typename Less>
+class loser_tree_t
+{
+public:
+    /// @brief Builds the tree.
+    /// @param _sources the number of sources, which must be positive.
+    /// @param _less the comparison function.
+    loser_tree_t(std::size_t _sources, Less _less)
+        : sources(_sources)
+        , less(_less)
+        , tree(_sources, _sources)
+    {
+        for (std::size_t source = 0; source < sources; ++source) {
+            this->replay(source);
+        }
+    }
+
+    /// @brief Returns the source with the smallest head.
+    /// @return the index of the source.
+    auto winner() const -> std::size_t { return tree[0]; }
+
+    /// @brief Updates the tree after the head of the winner has changed.
+    void advance() { this->replay(tree[0]); }
+
+private:
+    /// @brief Plays the matches from the leaf of the source up to the root.
+    /// @details While the tree is built, the first source reaching a node
+    /// waits there for the winner of the other subtree.
+    void replay(std::size_t source)
+    {
+        std::size_t winner = source;
+        for (std::size_t node = (source + sources) / 2; node > 0; node /= 2) {
+            if (tree[node] == sources) {
+                tree[node] = winner;
+                return;
+            }
+            if (less(tree[node], winner)) {
+                std::swap(tree[node], winner);
+            }
+        }
+        tree[0] = winner;
+    }
+
+    /// @brief The number of sources.
+    const std::size_t sources;
+    /// @brief The comparison function.
+    Less less;
+    /// @brief The loser of each match, and the overall winner in the first position.
+    std::vector<std::size_t> tree;
+};
+
+} // namespace detail
+
+/// @brief An ordered map which keeps in memory its keys, their order and its
+/// hot values, while the cold values are written to an append-only file.
+/// @details Each value accessed by `set` or `find` becomes resident, and
+/// resident values are kept in least-recently-used order. When their total
+/// weight (their size, plus the size of their encoding) exceeds the memory
+/// budget, the least recently used ones are evicted: if they were modified
+/// since they were last written, they are appended to the file, and their
+/// entry remembers the offset where to read them back. Hence, the resident
+/// values act as a cache of the file. Iterating the map reads the cold
+/// values without making them resident, so that a scan does not evict the
+/// hot values. Modified and erased values leave garbage inside the file,
+/// which `compact` removes. The file is created empty, and removed by the
+/// destructor, since it only extends the memory of the process.
+/// @tparam Key the type of the key.
+/// @tparam Value the value stored inside the map, with a `codec_t`.
+template <typename Key, typename Value>
+class tiered_ordered_map_t
+{
+private:
+    struct entry_t;
+    using list_t = std::list<entry_t>;
+
+public:
+    /// @brief The maximum number of runs merged at once by `external_sort`.
+    static constexpr std::size_t merge_fan_in = 64;
+
+    /// @brief The options of the map.
+    struct options_t {
+        /// @brief Construct the default options.
+        options_t()
+            : memory_budget(64U << 20U)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief The maximum weight of the resident values, in bytes.
+        std::size_t memory_budget;
+    };
+
+    /// @brief Constant iterator for the map, which yields a copy of each entry.
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::pair<Key, Value>;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const value_type *;
+        using reference         = const value_type &;
+
+        /// @brief Construct an iterator to the given entry.
+        const_iterator(const tiered_ordered_map_t *_map, typename list_t::const_iterator _it)
+            : map(_map)
+            , it(_it)
+            , current()
+            , loaded(false)
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Returns the entry, reading its value from the file if it is cold.
+        auto operator*() const -> reference
+        {
+            if (!loaded) {
+                current.first = it->key;
+                map->read(*it, current.second);
+                loaded = true;
+            }
+            return current;
+        }
+
+        /// @brief Returns the entry, reading its value from the file if it is cold.
+        auto operator->() const -> pointer { return &(**this); }
+
+        /// @brief Advances to the next entry.
+        auto operator++() -> const_iterator &
+        {
+            ++it;
+            loaded = false;
+            return *this;
+        }
+
+        /// @brief Checks if the two iterators point to the same entry.
+        auto operator==(const const_iterator &other) const -> bool { return it == other.it; }
+
+        /// @brief Checks if the two iterators point to different entries.
+        auto operator!=(const const_iterator &other) const -> bool { return it != other.it; }
+
+    private:
+        /// @brief The map.
+        const tiered_ordered_map_t *map;
+        /// @brief The entry.
+        typename list_t::const_iterator it;
+        /// @brief The copy of the entry.
+        mutable value_type current;
+        /// @brief If the copy is up to date.
+        mutable bool loaded;
+    };
+
+    /// @brief Construct an empty map.
+    /// @param _path the path of the file storing the cold values, which is truncated.
+    /// @param _options the options of the map.
+    /// @throws std::runtime_error if the file cannot be created.
+    explicit tiered_ordered_map_t(const std::string &_path, options_t _options = options_t())
+        : path(_path)
+        , options(_options)
+        , list()
+        , table()
+        , lru()
+        , file()
+        , resident_bytes(0)
+        , file_bytes(0)
+        , garbage_bytes(0)
+    {
+        this->open(std::ios::trunc);
+    }
+
+    /// @brief Removes the file.
+    ~tiered_ordered_map_t()
+    {
+        file.close();
+        std::remove(path.c_str());
+    }
+
+    tiered_ordered_map_t(const tiered_ordered_map_t &)                     = delete;
+    auto operator=(const tiered_ordered_map_t &) -> tiered_ordered_map_t & = delete;
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t { return list.size(); }
+
+    /// @brief Checks if the map is empty.
+    /// @return true if the map is empty, false otherwise.
+    auto empty() const -> bool { return list.empty(); }
+
+    /// @brief Returns the total weight of the resident values.
+    /// @return the weight, in bytes.
+    auto resident() const -> std::size_t { return resident_bytes; }
+
+    /// @brief Returns the size of the file.
+    /// @return the size, in bytes.
+    auto spilled() const -> std::uint64_t { return file_bytes; }
+
+    /// @brief Returns the size of the values inside the file which are no longer used.
+    /// @return the size, in bytes.
+    auto garbage() const -> std::uint64_t { return garbage_bytes; }
+
+    /// @brief Returns a const iterator the beginning of the map.
+    /// @return an iterator to the beginning of the map.
+    auto begin() const -> const_iterator { return const_iterator(this, list.begin()); }
+
+    /// @brief Returns a const iterator the end of the map.
+    /// @return an iterator to the end of the map.
+    auto end() const -> const_iterator { return const_iterator(this, list.end()); }
+
+    /// @brief Returns an iterator to the element in the given position.
+    /// @param position the position of the element to retrieve.
+    /// @return an iterator to the element, or the end of the map if not found.
+    auto at(std::size_t position) const -> const_iterator
+    {
+        typename list_t::const_iterator it = list.begin();
+        std::advance(it, std::min(position, list.size()));
+        return const_iterator(this, it);
+    }
+
+    /// @brief Returns an iterator to the element associated with the given
+    /// key, making its value resident.
+    /// @param key the key of the element to search for.
+    /// @return an iterator to the element, or the end of the map if not found.
+    auto find(const Key &key) -> const_iterator
+    {
+        typename table_t::iterator it = table.find(key);
+        if (it == table.end()) {
+            return this->end();
+        }
+        entry_t &entry = *it->second;
+        if (!entry.value) {
+            std::unique_ptr<Value> value(new Value());
+            this->read(entry, *value);
+            entry.value  = std::move(value);
+            entry.weight = sizeof(Value) + static_cast<std::size_t>(entry.size);
+            entry.lru    = lru.insert(lru.end(), it->second);
+            resident_bytes += entry.weight;
+        } else {
+            lru.splice(lru.end(), lru, entry.lru);
+        }
+        const_iterator result(this, it->second);
+        // Read the entry before the value is evicted again by a tiny budget.
+        static_cast<void>(*result);
+        this->evict();
+        return result;
+    }
+
+    /// @brief Sets/updates the `<key,value>` pair inside the map.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    void set(const Key &key, const Value &value)
+    {
+        typename table_t::iterator it = table.find(key);
+        if (it == table.end()) {
+            typename list_t::iterator entry = list.emplace(list.end(), key);
+            it                              = table.emplace(key, entry).first;
+        }
+        entry_t &entry = *it->second;
+        if (entry.value) {
+            *entry.value = value;
+            resident_bytes -= entry.weight;
+            lru.splice(lru.end(), lru, entry.lru);
+        } else {
+            entry.value.reset(new Value(value));
+            entry.lru = lru.insert(lru.end(), it->second);
+        }
+        // The copy inside the file, if any, is now stale.
+        this->discard(entry);
+        entry.weight = sizeof(Value) + detail::encoded_size(value);
+        resident_bytes += entry.weight;
+        this->evict();
+    }
+
+    /// @brief Erases the element associated with the given key.
+    /// @param key the key of the element to remove.
+    /// @return true if the element was removed, false otherwise.
+    auto erase(const Key &key) -> bool
+    {
+        typename table_t::iterator it = table.find(key);
+        if (it == table.end()) {
+            return false;
+        }
+        entry_t &entry = *it->second;
+        if (entry.value) {
+            resident_bytes -= entry.weight;
+            lru.erase(entry.lru);
+        }
+        this->discard(entry);
+        list.erase(it->second);
+        table.erase(it);
+        return true;
+    }
+
+    /// @brief Sorts the map, using temporary files so that only a part of the
+    /// entries is in memory at any time.
+    /// @param fun the comparison function, called as
+    /// `fun(const std::pair<Key, Value> &, const std::pair<Key, Value> &)`.
+    /// @param tmp_dir the directory of the temporary files.
+    /// @param mem_budget the maximum weight of the entries sorted in memory, in bytes.
+    /// @details The entries are copied, in insertion order, into runs whose
+    /// weight is within the budget; each run is sorted and written to a
+    /// temporary file. Then, the runs are merged with a loser tree, reading one
+    /// entry at a time from each of them, and each merged entry is moved to
+    /// the end of the list. At most `merge_fan_in` runs are open at once: when
+    /// there are more, groups of runs are first merged into longer runs, with
+    /// as many passes as needed. The sort is stable, and only moves the list nodes,
+    /// so the values stay where they are. When all the entries fit in a single
+    /// run, no file is written. If an exception is thrown, the map keeps all
+    /// its entries, in an unspecified order.
+    /// @throws std::runtime_error if a temporary file cannot be written or read.
+    template <typename Compare>
+    void external_sort(Compare fun, const std::string &tmp_dir, std::size_t mem_budget)
+    {
+        using record_t = std::pair<std::uint64_t, std::pair<Key, Value>>;
+        auto before    = [&fun](const record_t &lhs, const record_t &rhs) {
+            if (fun(lhs.second, rhs.second)) {
+                return true;
+            }
+            return !fun(rhs.second, lhs.second) && (lhs.first < rhs.first);
+        };
+        run_files_t files;
+        std::vector<std::uint64_t> counts;
+        std::vector<record_t> run;
+        std::size_t weight     = 0;
+        std::uint64_t sequence = 0;
+        // Adds a new temporary file.
+        auto create = [&]() -> const std::string & {
+            files.paths.push_back(tmp_dir + "/ordered_map_run_" +
+                                  std::to_string(reinterpret_cast<std::uintptr_t>(this)) + "_" +
+                                  std::to_string(files.paths.size()));
+            return files.paths.back();
+        };
+        auto write = [](std::ostream &output, const record_t &record) {
+            codec_t<std::uint64_t>::encode(output, record.first);
+            codec_t<Key>::encode(output, record.second.first);
+            codec_t<Value>::encode(output, record.second.second);
+        };
+        auto spill = [&]() {
+            std::stable_sort(run.begin(), run.end(), before);
+            const std::string &path_of_run = create();
+            std::ofstream output(path_of_run, std::ios::binary | std::ios::trunc);
+            for (const record_t &record : run) {
+                write(output, record);
+            }
+            output.close();
+            if (!output) {
+                throw std::runtime_error("tiered_ordered_map_t: cannot write " + path_of_run);
+            }
+            counts.push_back(run.size());
+            run.clear();
+            weight = 0;
+        };
+        for (const entry_t &entry : list) {
+            run.emplace_back(sequence++, std::make_pair(entry.key, Value()));
+            this->read(entry, run.back().second.second);
+            weight += sizeof(record_t) + detail::encoded_size(entry.key) +
+                      detail::encoded_size(run.back().second.second);
+            if ((weight > mem_budget) && (run.size() > 1)) {
+                spill();
+            }
+        }
+        if (files.paths.empty()) {
+            std::stable_sort(run.begin(), run.end(), before);
+            for (const record_t &record : run) {
+                list.splice(list.end(), list, table.find(record.second.first)->second);
+            }
+            return;
+        }
+        if (!run.empty()) {
+            spill();
+        }
+        // Merges the given runs, keeping the head of each one, and passes
+        // each record to the sink, in order.
+        auto merge = [&](const std::vector<std::size_t> &group, const std::function<void(const record_t &)> &sink) {
+            std::vector<std::unique_ptr<std::ifstream>> inputs;
+            std::vector<record_t> heads(group.size());
+            std::vector<std::uint64_t> left(group.size());
+            std::vector<bool> exhausted(group.size(), false);
+            auto next = [&](std::size_t index) {
+                --left[index];
+                codec_t<std::uint64_t>::decode(*inputs[index], heads[index].first);
+                codec_t<Key>::decode(*inputs[index], heads[index].second.first);
+                codec_t<Value>::decode(*inputs[index], heads[index].second.second);
+            };
+            std::uint64_t total = 0;
+            for (std::size_t index = 0; index < group.size(); ++index) {
+                inputs.emplace_back(new std::ifstream(files.paths[group[index]], std::ios::binary));
+                if (!*inputs.back()) {
+                    throw std::runtime_error("tiered_ordered_map_t: cannot read " + files.paths[group[index]]);
+                }
+                left[index] = counts[group[index]];
+                total += left[index];
+                if (left[index] == 0) {
+                    exhausted[index] = true;
+                } else {
+                    next(index);
+                }
+            }
+            auto less = [&](std::size_t lhs, std::size_t rhs) {
+                return !exhausted[lhs] && (exhausted[rhs] || before(heads[lhs], heads[rhs]));
+            };
+            detail::loser_tree_t<decltype(less)> tree(group.size(), less);
+            for (std::uint64_t remaining = total; remaining > 0; --remaining) {
+                const std::size_t winner = tree.winner();
+                sink(heads[winner]);
+                if (left[winner] == 0) {
+                    exhausted[winner] = true;
+                } else {
+                    next(winner);
+                }
+                tree.advance();
+            }
+        };
+        // Merge groups of runs into longer ones, until they can be merged at once.
+        std::vector<std::size_t> runs;
+        for (std::size_t index = 0; index < files.paths.size(); ++index) {
+            runs.push_back(index);
+        }
+        const std::size_t fan_in = merge_fan_in;
+        while (runs.size() > fan_in) {
+            std::vector<std::size_t> merged;
+            for (std::size_t first = 0; first < runs.size(); first += fan_in) {
+                const std::vector<std::size_t> group(
+                    runs.begin() + static_cast<std::ptrdiff_t>(first),
+                    runs.begin() + static_cast<std::ptrdiff_t>(std::min(first + fan_in, runs.size())));
+                if (group.size() == 1) {
+                    merged.push_back(group.front());
+                    continue;
+                }
+                const std::string &path_of_run = create();
+                std::ofstream output(path_of_run, std::ios::binary | std::ios::trunc);
+                std::uint64_t count = 0;
+                merge(group, [&](const record_t &record) {
+                    write(output, record);
+                    ++count;
+                });
+                output.close();
+                if (!output) {
+                    throw std::runtime_error("tiered_ordered_map_t: cannot write " + path_of_run);
+                }
+                counts.push_back(count);
+                merged.push_back(files.paths.size() - 1);
+                // The merged runs are not needed anymore.
+                for (std::size_t index : group) {
+                    std::remove(files.paths[index].c_str());
+                }
+            }
+            runs.swap(merged);
+        }
+        merge(runs, [this](const record_t &record) {
+            list.splice(list.end(), list, table.find(record.second.first)->second);
+        });
+    }
+
+    /// @brief Rewrites the file, keeping only the values which are still used.
+    /// @throws std::runtime_error if the new file cannot be written.
+    void compact()
+    {
+        const std::string temporary = path + ".compact";
+        std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+        std::vector<std::uint64_t> offsets;
+        std::vector<char> buffer;
+        std::uint64_t written = 0;
+        for (const entry_t &entry : list) {
+            if (entry.size == 0) {
+                continue;
+            }
+            buffer.resize(static_cast<std::size_t>(entry.size));
+            file.clear();
+            file.seekg(static_cast<std::streamoff>(entry.offset));
+            detail::read_bytes(file, buffer.data(), buffer.size());
+            detail::write_bytes(output, buffer.data(), buffer.size());
+            offsets.push_back(written);
+            written += entry.size;
+        }
+        output.close();
+        if (!output) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("tiered_ordered_map_t: cannot write " + temporary);
+        }
+        file.close();
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            this->open(std::ios::in);
+            throw std::runtime_error("tiered_ordered_map_t: cannot replace " + path);
+        }
+        this->open(std::ios::in);
+        std::vector<std::uint64_t>::const_iterator offset = offsets.begin();
+        for (entry_t &entry : list) {
+            if (entry.size != 0) {
+                entry.offset = *offset++;
+            }
+        }
+        file_bytes    = written;
+        garbage_bytes = 0;
+    }
+
+private:
+    /// @brief An entry of the map.
+    struct entry_t {
+        /// @brief Construct an entry without a value.
+        explicit entry_t(const Key &_key)
+            : key(_key)
+            , value()
+            , offset(0)
+            , size(0)
+            , weight(0)
+            , lru()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief The key.
+        Key key;
+        /// @brief The value, if resident.
+        std::unique_ptr<Value> value;
+        /// @brief The offset of the value inside the file.
+        std::uint64_t offset;
+        /// @brief The size of the value inside the file, zero if it is not there.
+        std::uint64_t size;
+        /// @brief The weight of the value, if resident.
+        std::size_t weight;
+        /// @brief The position inside the least-recently-used list, if resident.
+        typename std::list<typename list_t::iterator>::iterator lru;
+    };
+
+    /// @brief The type of the table.
+    using table_t = std::map<Key, typename list_t::iterator>;
+
+    /// @brief Removes the temporary files of the external sort.
+    struct run_files_t {
+        /// @brief Construct an empty set of files.
+        run_files_t()
+            : paths()
+        {
+            // Nothing to do.
+        }
+
+        /// @brief Removes the files.
+        ~run_files_t()
+        {
+            for (const std::string &file : paths) {
+                std::remove(file.c_str());
+            }
+        }
+
+        /// @brief The paths of the files.
+        std::vector<std::string> paths;
+    };
+
+    /// @brief Opens the file for reading and writing.
+    /// @param mode the additional mode.
+    void open(std::ios::openmode mode)
+    {
+        file.open(path, std::ios::binary | std::ios::in | std::ios::out | mode);
+        if (!file) {
+            throw std::runtime_error("tiered_ordered_map_t: cannot open " + path);
+        }
+    }
+
+    /// @brief Copies the value of the entry, reading it from the file if it is cold.
+    void read(const entry_t &entry, Value &value) const
+    {
+        if (entry.value) {
+            value = *entry.value;
+            return;
+        }
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(entry.offset));
+        codec_t<Value>::decode(file, value);
+    }
+
+    /// @brief Marks the copy of the value inside the file as garbage.
+    void discard(entry_t &entry)
+    {
+        garbage_bytes += entry.size;
+        entry.size = 0;
+    }
+
+    /// @brief Evicts the least recently used values, until the budget is respected.
+    /// @details The values missing from the file are written and flushed
+    /// first, and dropped from memory only if that succeeded.
+    /// @throws std::runtime_error if the file cannot be written, in which case
+    /// the values stay resident, and are written again by the next eviction.
+    void evict()
+    {
+        const std::uint64_t previous_bytes = file_bytes;
+        std::size_t victims                = 0;
+        std::size_t evicted                = 0;
+        // The values from the front of the list to this one are evicted.
+        typename std::list<typename list_t::iterator>::iterator it = lru.begin();
+        try {
+            for (; (it != lru.end()) && (resident_bytes - evicted > options.memory_budget); ++it, ++victims) {
+                entry_t &entry = **it;
+                if (entry.size == 0) {
+                    file.clear();
+                    file.seekp(static_cast<std::streamoff>(file_bytes));
+                    codec_t<Value>::encode(file, *entry.value);
+                    const std::streamoff end = file.tellp();
+                    if (!file || (end < 0)) {
+                        throw std::runtime_error("tiered_ordered_map_t: cannot write " + path);
+                    }
+                    entry.offset = file_bytes;
+                    entry.size   = static_cast<std::uint64_t>(end) - file_bytes;
+                    file_bytes += entry.size;
+                }
+                evicted += entry.weight;
+            }
+            if (!file.flush()) {
+                throw std::runtime_error("tiered_ordered_map_t: cannot write " + path);
+            }
+        } catch (...) {
+            // Forget the copies written by this eviction, they might be incomplete.
+            for (typename std::list<typename list_t::iterator>::iterator victim = lru.begin(); victim != it;
+                 ++victim) {
+                if ((*victim)->offset >= previous_bytes) {
+                    (*victim)->size = 0;
+                }
+            }
+            file_bytes = previous_bytes;
+            file.clear();
+            throw;
+        }
+        for (; victims > 0; --victims) {
+            entry_t &entry = *lru.front();
+            entry.value.reset();
+            resident_bytes -= entry.weight;
+            lru.pop_front();
+        }
+    }
+
+    /// @brief The path of the file.
+    const std::string path;
+    /// @brief The options.
+    const options_t options;
+    /// @brief The entries, in insertion order.
+    list_t list;
+    /// @brief Associates each key with its entry.
+    table_t table;
+    /// @brief The entries with a resident value, from the least recently used.
+    std::list<typename list_t::iterator> lru;
+    /// @brief The file storing the cold values.
+    mutable std::fstream file;
+    /// @brief The total weight of the resident values.
+    std::size_t resident_bytes;
+    /// @brief The size of the file.
+    std::uint64_t file_bytes;
+    /// @brief The size of the values inside the file which are no longer used.
+    std::uint64_t garbage_bytes;
+};
+
+} // namespace ordered_map
@@ -0,0 +1,369 @@
+/// @file tracked_ordered_map.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief An ordered map which tracks its changes, to replicate them incrementally.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include "ordered_map/ordered_map.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace ordered_map
+{
+
+/// @brief The changes applied to a map between two versions.
+/// @tparam Key the type of the key.
+/// @tparam Value the value stored inside the map.
+template <typename Key, typename Value>
+struct delta_t {
+    /// @brief Construct an empty delta.
+    delta_t()
+        : from(0)
+        , to(0)
+        , full(false)
+        , reordered(false)
+        , erased()
+        , updated()
+        , appended()
+        , order()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief The version the delta starts from.
+    std::uint64_t from;
+    /// @brief The version reached by applying the delta.
+    std::uint64_t to;
+    /// @brief If the delta contains the whole map, which must be cleared first.
+    bool full;
+    /// @brief If the map has been reordered, and `order` contains all the keys.
+    bool reordered;
+    /// @brief The erased keys.
+    std::vector<Key> erased;
+    /// @brief The new values of the keys which already existed.
+    std::vector<std::pair<Key, Value>> updated;
+    /// @brief The new keys, in insertion order.
+    std::vector<std::pair<Key, Value>> appended;
+    /// @brief All the keys, in their new order, if the map has been reordered.
+    std::vector<Key> order;
+
+    /// @brief Writes the delta to a stream, using the codecs of `codec.hpp`.
+    /// @param stream the output stream.
+    void save(std::ostream &stream) const
+    {
+        codec_t<std::uint64_t>::encode(stream, from);
+        codec_t<std::uint64_t>::encode(stream, to);
+        const auto flags = static_cast<std::uint8_t>((full ? 1U : 0U) | (reordered ? 2U : 0U));
+        codec_t<std::uint8_t>::encode(stream, flags);
+        delta_t::save_keys(stream, erased);
+        delta_t::save_entries(stream, updated);
+        delta_t::save_entries(stream, appended);
+        delta_t::save_keys(stream, order);
+    }
+
+    /// @brief Reads the delta from a stream, written by `save`.
+    /// @param stream the input stream.
+    /// @throws std::runtime_error if the stream is truncated.
+    void load(std::istream &stream)
+    {
+        std::uint8_t flags = 0;
+        codec_t<std::uint64_t>::decode(stream, from);
+        codec_t<std::uint64_t>::decode(stream, to);
+        codec_t<std::uint8_t>::decode(stream, flags);
+        full      = (flags & 1U) != 0;
+        reordered = (flags & 2U) != 0;
+        delta_t::load_keys(stream, erased);
+        delta_t::load_entries(stream, updated);
+        delta_t::load_entries(stream, appended);
+        delta_t::load_keys(stream, order);
+    }
+
+private:
+    /// @brief Writes a vector of keys.
+    static void save_keys(std::ostream &stream, const std::vector<Key> &keys)
+    {
+        codec_t<std::uint64_t>::encode(stream, static_cast<std::uint64_t>(keys.size()));
+        for (const Key &key : keys) {
+            codec_t<Key>::encode(stream, key);
+        }
+    }
+
+    /// @brief Writes a vector of entries.
+    static void save_entries(std::ostream &stream, const std::vector<std::pair<Key, Value>> &entries)
+    {
+        codec_t<std::uint64_t>::encode(stream, static_cast<std::uint64_t>(entries.size()));
+        for (const std::pair<Key, Value> &entry : entries) {
+            codec_t<Key>::encode(stream, entry.first);
+            codec_t<Value>::encode(stream, entry.second);
+        }
+    }
+
+    /// @brief Reads a vector of keys.
+    static void load_keys(std::istream &stream, std::vector<Key> &keys)
+    {
+        std::uint64_t count = 0;
+        codec_t<std::uint64_t>::decode(stream, count);
+        keys.clear();
+        for (std::uint64_t index = 0; index < count; ++index) {
+            keys.emplace_back();
+            codec_t<Key>::decode(stream, keys.back());
+        }
+    }
+
+    /// @brief Reads a vector of entries.
+    static void load_entries(std::istream &stream, std::vector<std::pair<Key, Value>> &entries)
+    {
+        std::uint64_t count = 0;
+        codec_t<std::uint64_t>::decode(stream, count);
+        entries.clear();
+        for (std::uint64_t index = 0; index < count; ++index) {
+            entries.emplace_back();
+            codec_t<Key>::decode(stream, entries.back().first);
+            codec_t<Value>::decode(stream, entries.back().second);
+        }
+    }
+};
+
+/// @brief Applies a delta to a replica of a tracked map.
+/// @param map the replica, which must be at version `delta.from` (unless the delta is full).
+/// @param delta the delta.
+/// @details Keys are erased, updated and appended, in this order, so that the
+/// new keys keep the insertion order of the source. A key erased and
+/// inserted again on the source is moved to the end. Finally, if the source
+/// has been reordered, the replica follows the new order.
+/// @throws std::runtime_error if the new order does not list all the keys of
+/// the replica, which is then left with the changes but not reordered.
+template <typename Key, typename Value>
+void apply_delta(ordered_map_t<Key, Value> &map, const delta_t<Key, Value> &delta)
+{
+    if (delta.full) {
+        map.clear();
+    }
+    map.erase_keys(delta.erased.begin(), delta.erased.end());
+    for (const std::pair<Key, Value> &entry : delta.updated) {
+        map.set(entry.first, entry.second);
+    }
+    for (const std::pair<Key, Value> &entry : delta.appended) {
+        map.erase(entry.first);
+    }
+    map.append(delta.appended.begin(), delta.appended.end());
+    if (delta.reordered) {
+        std::map<Key, std::size_t> rank;
+        for (std::size_t index = 0; index < delta.order.size(); ++index) {
+            rank.emplace(delta.order[index], index);
+        }
+        for (typename ordered_map_t<Key, Value>::const_iterator it = map.begin(); it != map.end(); ++it) {
+            if (rank.find(it->first) == rank.end()) {
+                throw std::runtime_error("apply_delta: the order does not match the replica");
+            }
+        }
+        map.parallel_sort(
+            [&rank](const std::pair<Key, Value> &lhs, const std::pair<Key, Value> &rhs) {
+                return rank.find(lhs.first)->second < rank.find(rhs.first)->second;
+            },
+            sequential_executor_t());
+    }
+}
+
+/// @brief An ordered map which assigns a version to each modification, and
+/// computes the changes applied since a given version.
+/// @details Each key remembers the version which inserted it and the one
+/// which last modified it, erased keys leave a tombstone, and an index sorted
+/// by version points to the last change of each key. Hence, the cost of
+/// `changes_since` is proportional to the number of keys changed since then,
+/// not to the size of the map, unless the map has been reordered in the
+/// meantime. Tombstones can be dropped with `forget_before`, once all the
+/// replicas have reached a version; older replicas then receive a full delta.
+/// @tparam Key the type of the key.
+/// @tparam Value the value stored inside the map.
+template <typename Key, typename Value>
+class tracked_ordered_map_t
+{
+public:
+    /// @brief The type of the wrapped map.
+    using map_t      = ordered_map_t<Key, Value>;
+    /// @brief The type of the deltas.
+    using delta_type = delta_t<Key, Value>;
+
+    /// @brief Construct a new, empty, map.
+    tracked_ordered_map_t()
+        : map()
+        , versions()
+        , tombstones()
+        , erasures()
+        , changes()
+        , current(0)
+        , reordered(0)
+        , oldest(0)
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Returns the wrapped map, which must be modified only through this class.
+    /// @return a reference to the map.
+    auto get() const -> const map_t & { return map; }
+
+    /// @brief Returns the current version.
+    /// @return the version of the last modification.
+    auto version() const -> std::uint64_t { return current; }
+
+    /// @brief Returns the number of element in the map.
+    /// @return the number of elements.
+    auto size() const -> std::size_t { return map.size(); }
+
+    /// @brief Sets/updates the `<key,value>` pair inside the map.
+    /// @param key the value identifier.
+    /// @param value the actual value.
+    void set(const Key &key, const Value &value)
+    {
+        map.set(key, value);
+        typename versions_t::iterator it = versions.find(key);
+        if (it != versions.end()) {
+            changes.erase(it->second.second);
+            it->second.second = ++current;
+        } else {
+            typename tombstones_t::iterator tombstone = tombstones.find(key);
+            if (tombstone != tombstones.end()) {
+                changes.erase(tombstone->second);
+                erasures.erase(tombstone->second);
+                tombstones.erase(tombstone);
+            }
+            ++current;
+            versions.emplace(key, std::make_pair(current, current));
+        }
+        changes.emplace(current, key);
+    }
+
+    /// @brief Erases the element associated with the given key.
+    /// @param key the key of the element to remove.
+    /// @return true if the element was removed, false otherwise.
+    auto erase(const Key &key) -> bool
+    {
+        typename versions_t::iterator it = versions.find(key);
+        if (it == versions.end()) {
+            return false;
+        }
+        map.erase(key);
+        changes.erase(it->second.second);
+        versions.erase(it);
+        tombstones.emplace(key, ++current);
+        erasures.emplace(current, key);
+        changes.emplace(current, key);
+        return true;
+    }
+
+    /// @brief Removes all the elements.
+    void clear()
+    {
+        while (map.size() > 0) {
+            Key key = map.begin()->first;
+            this->erase(key);
+        }
+    }
+
+    /// @brief Sorts the map.
+    /// @param fun the comparison function, between two `list_entry_t`.
+    template <typename Compare>
+    void sort(Compare fun)
+    {
+        map.parallel_sort(fun, sequential_executor_t());
+        reordered = ++current;
+    }
+
+    /// @brief Computes the changes applied after the given version.
+    /// @param since the version of the replica.
+    /// @return the delta which brings the replica to the current version.
+    auto changes_since(std::uint64_t since) const -> delta_type
+    {
+        delta_type delta;
+        delta.from = since;
+        delta.to   = current;
+        if (since < oldest) {
+            // The tombstones needed by the replica are gone.
+            delta.full = true;
+            delta.appended.assign(map.begin(), map.end());
+            return delta;
+        }
+        // The new keys are sorted by the version which inserted them.
+        std::vector<std::pair<std::uint64_t, typename map_t::const_iterator>> inserted;
+        for (typename changes_t::const_iterator it = changes.upper_bound(since); it != changes.end(); ++it) {
+            typename versions_t::const_iterator version = versions.find(it->second);
+            if (version == versions.end()) {
+                delta.erased.push_back(it->second);
+            } else if (version->second.first > since) {
+                inserted.emplace_back(version->second.first, map.find(it->second));
+            } else {
+                delta.updated.emplace_back(it->second, map.find(it->second)->second);
+            }
+        }
+        std::sort(inserted.begin(), inserted.end(),
+                  [](const std::pair<std::uint64_t, typename map_t::const_iterator> &lhs,
+                     const std::pair<std::uint64_t, typename map_t::const_iterator> &rhs) {
+                      return lhs.first < rhs.first;
+                  });
+        for (const std::pair<std::uint64_t, typename map_t::const_iterator> &entry : inserted) {
+            delta.appended.push_back(*entry.second);
+        }
+        if (reordered > since) {
+            delta.reordered = true;
+            for (typename map_t::const_iterator it = map.begin(); it != map.end(); ++it) {
+                delta.order.push_back(it->first);
+            }
+        }
+        return delta;
+    }
+
+    /// @brief Drops the tombstones of the keys erased up to the given
+    /// version, because all the replicas have reached it.
+    /// @param version the oldest version of the replicas.
+    /// @details Replicas older than that will receive a full delta. The cost
+    /// is proportional to the number of dropped tombstones.
+    void forget_before(std::uint64_t version)
+    {
+        typename changes_t::iterator it = erasures.begin();
+        while ((it != erasures.end()) && (it->first <= version)) {
+            tombstones.erase(it->second);
+            changes.erase(it->first);
+            it = erasures.erase(it);
+        }
+        oldest = std::max(oldest, version);
+    }
+
+private:
+    /// @brief For each key, the version which inserted it and the one which last modified it.
+    using versions_t   = std::map<Key, std::pair<std::uint64_t, std::uint64_t>>;
+    /// @brief For each erased key, the version which erased it.
+    using tombstones_t = std::map<Key, std::uint64_t>;
+    /// @brief The last change of each key, sorted by version.
+    using changes_t    = std::map<std::uint64_t, Key>;
+
+    /// @brief The map.
+    map_t map;
+    /// @brief The versions of the keys.
+    versions_t versions;
+    /// @brief The tombstones of the erased keys.
+    tombstones_t tombstones;
+    /// @brief The erased keys, sorted by the version which erased them.
+    changes_t erasures;
+    /// @brief The last change of each key, sorted by version.
+    changes_t changes;
+    /// @brief The current version.
+    std::uint64_t current;
+    /// @brief The version of the last reordering.
+    std::uint64_t reordered;
+    /// @brief The oldest version from which a partial delta can be computed.
+    std::uint64_t oldest;
+};
+
+} // namespace ordered_map
@@ -0,0 +1,451 @@
+/// @file work_stealing_pool.hpp
+/// @author Enrico Fraccaroli (enry.frak@gmail.com)
+/// @brief A small work-stealing scheduler, used by the parallel algorithms.
+///
+/// @copyright (c) 2024 This file is distributed under the MIT License.
+/// See LICENSE.md for details.
+///
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace ordered_map
+{
+
+/// @brief This namespace contains the implementation details.
+namespace detail
+{
+
+/// @brief A task which can be executed by the pool.
+class pool_task_t
+{
+public:
+    /// @brief Construct a new task.
+    pool_task_t()
+        : done(false)
+        , error()
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Destructor.
+    virtual ~pool_task_t() = default;
+
+    pool_task_t(const pool_task_t &)                     = delete;
+    pool_task_t(pool_task_t &&)                          = delete;
+    auto operator=(const pool_task_t &) -> pool_task_t & = delete;
+    auto operator=(pool_task_t &&) -> pool_task_t &      = delete;
+
+    /// @brief Executes the task, and marks it as done.
+    void execute()
+    {
+        try {
+            this->run();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        done.store(true, std::memory_order_release);
+    }
+
+    /// @brief Checks if the task is done.
+    /// @return true if the task is done.
+    auto is_done() const -> bool { return done.load(std::memory_order_acquire); }
+
+    /// @brief Re-throws the exception thrown by the task, if any.
+    void rethrow() const
+    {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+protected:
+    /// @brief The actual work of the task.
+    virtual void run() = 0;
+
+private:
+    /// @brief If the task is done.
+    std::atomic<bool> done;
+    /// @brief The exception thrown by the task, if any.
+    std::exception_ptr error;
+};
+
+/// @brief A task calling a function, which lives on the stack of the caller.
+/// @tparam Function the type of the function.
+template <typename Function>
+class function_task_t : public pool_task_t
+{
+public:
+    /// @brief Construct a new task.
+    /// @param _fun the function.
+    explicit function_task_t(Function &_fun)
+        : fun(_fun)
+    {
+        // Nothing to do.
+    }
+
+protected:
+    /// @brief Calls the function.
+    void run() override { fun(); }
+
+private:
+    /// @brief The function.
+    Function &fun;
+};
+
+/// @brief A Chase-Lev deque: the owner pushes and pops at the bottom, while
+/// the other workers steal from the top.
+class task_deque_t
+{
+public:
+    /// @brief Construct a new, empty, deque.
+    /// @param capacity the capacity, it must be a power of two.
+    explicit task_deque_t(std::size_t capacity)
+        : top(0)
+        , bottom(0)
+        , mask(static_cast<std::int64_t>(capacity) - 1)
+        , buffer(new std::atomic<pool_task_t *>[capacity]())
+    {
+        // Nothing to do.
+    }
+
+    /// @brief Pushes a task at the bottom (owner only).
+    /// @param task the task.
+    /// @return false if the deque is full.
+    auto push(pool_task_t *task) -> bool
+    {
+        std::int64_t b = bottom.load(std::memory_order_relaxed);
+        std::int64_t t = top.load(std::memory_order_acquire);
+        if ((b - t) > mask) {
+            return false;
+        }
+        buffer[static_cast<std::size_t>(b & mask)].store(task, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_seq_cst);
+        return true;
+    }
+
+    /// @brief Pops a task from the bottom (owner only).
+    /// @return the task, or null if the deque is empty.
+    auto pop() -> pool_task_t *
+    {
+        std::int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_seq_cst);
+        std::int64_t t = top.load(std::memory_order_seq_cst);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        pool_task_t *task = buffer[static_cast<std::size_t>(b & mask)].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last task, race against the thieves.
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst)) {
+                task = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    /// @brief Steals a task from the top (any thread).
+    /// @return the task, or null if the deque is empty or the race was lost.
+    auto steal() -> pool_task_t *
+    {
+        std::int64_t t = top.load(std::memory_order_seq_cst);
+        std::int64_t b = bottom.load(std::memory_order_seq_cst);
+        if (t >= b) {
+            return nullptr;
+        }
+        pool_task_t *task = buffer[static_cast<std::size_t>(t & mask)].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst)) {
+            return nullptr;
+        }
+        return task;
+    }
+
+private:
+    /// @brief The index of the top, where thieves steal.
+    std::atomic<std::int64_t> top;
+    /// @brief The index of the bottom, where the owner pushes and pops.
+    std::atomic<std::int64_t> bottom;
+    /// @brief The mask used to wrap the indices around the buffer.
+    std::int64_t mask;
+    /// @brief The circular buffer.
+    std::unique_ptr<std::atomic<pool_task_t *>[]> buffer;
+};
+
+} // namespace detail
+
+/// @brief A pool of threads which balance the load by stealing tasks from
+/// each other.
+/// @details Each worker owns a Chase-Lev deque, where it pushes the tasks it
+/// forks. Idle workers steal from the other deques. Tasks submitted from
+/// outside the pool go through a shared queue. The pool satisfies the
+/// executor concept (see `executor.hpp`), and also provides a fork-join
+/// `invoke`.
+class work_stealing_pool_t
+{
+public:
+    /// @brief Construct a new pool.
+    /// @param threads the number of workers, zero to use all the hardware threads.
+    explicit work_stealing_pool_t(std::size_t threads = 0)
+        : workers()
+        , deques()
+        , injected()
+        , injected_count(0)
+        , sleepers(0)
+        , mutex()
+        , wakeup()
+        , stopping(false)
+    {
+        if (threads == 0) {
+            threads = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+        }
+        for (std::size_t index = 0; index < threads; ++index) {
+            deques.emplace_back(new detail::task_deque_t(deque_capacity));
+        }
+        for (std::size_t index = 0; index < threads; ++index) {
+            workers.emplace_back(&work_stealing_pool_t::worker_loop, this, index);
+        }
+    }
+
+    /// @brief Stops and joins all the workers.
+    ~work_stealing_pool_t()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wakeup.notify_all();
+        for (std::thread &worker : workers) {
+            worker.join();
+        }
+    }
+
+    work_stealing_pool_t(const work_stealing_pool_t &)                     = delete;
+    work_stealing_pool_t(work_stealing_pool_t &&)                          = delete;
+    auto operator=(const work_stealing_pool_t &) -> work_stealing_pool_t & = delete;
+    auto operator=(work_stealing_pool_t &&) -> work_stealing_pool_t &      = delete;
+
+    /// @brief Returns the number of tasks that can run at once.
+    /// @return the number of workers.
+    auto concurrency() const -> std::size_t { return workers.size(); }
+
+    /// @brief Runs the two functions, possibly in parallel, and waits for both.
+    /// @param first the first function, called as `first()`.
+    /// @param second the second function, called as `second()`.
+    template <typename First, typename Second>
+    void invoke(First first, Second second) const
+    {
+        if (this->current_worker() == nullptr) {
+            // Enter the pool, then fork from inside.
+            this->run_root([this, &first, &second]() { this->fork_join(first, second); });
+            return;
+        }
+        this->fork_join(first, second);
+    }
+
+    /// @brief Calls the function on each index, using all the workers.
+    /// @param count the number of indices.
+    /// @param fun the function, called as `fun(std::size_t)`.
+    template <typename Function>
+    void parallel_for(std::size_t count, Function fun) const
+    {
+        if (count == 0) {
+            return;
+        }
+        const std::size_t grain = std::max<std::size_t>(1, count / (this->concurrency() * 8));
+        this->invoke([this, &fun, count, grain]() { this->split(0, count, grain, fun); }, []() {});
+    }
+
+private:
+    /// @brief The capacity of each deque.
+    static constexpr std::size_t deque_capacity = 8192;
+
+    /// @brief Returns the deque of the calling thread, if it is a worker of this pool.
+    auto current_worker() const -> detail::task_deque_t *
+    {
+        std::pair<const work_stealing_pool_t *, detail::task_deque_t *> &current = work_stealing_pool_t::current();
+        return (current.first == this) ? current.second : nullptr;
+    }
+
+    /// @brief Returns the pool and the deque of the calling worker.
+    static auto current() -> std::pair<const work_stealing_pool_t *, detail::task_deque_t *> &
+    {
+        static thread_local std::pair<const work_stealing_pool_t *, detail::task_deque_t *> value(nullptr, nullptr);
+        return value;
+    }
+
+    /// @brief Recursively splits the range of indices.
+    template <typename Function>
+    void split(std::size_t begin, std::size_t end, std::size_t grain, Function &fun) const
+    {
+        if ((end - begin) <= grain) {
+            for (std::size_t index = begin; index < end; ++index) {
+                fun(index);
+            }
+            return;
+        }
+        std::size_t middle = begin + ((end - begin) / 2);
+        this->fork_join(
+            [this, begin, middle, grain, &fun]() { this->split(begin, middle, grain, fun); },
+            [this, middle, end, grain, &fun]() { this->split(middle, end, grain, fun); });
+    }
+
+    /// @brief Forks the second function, runs the first one, and joins.
+    template <typename First, typename Second>
+    void fork_join(First first, Second second) const
+    {
+        detail::task_deque_t *deque = this->current_worker();
+        detail::function_task_t<Second> forked(second);
+        if (!deque->push(&forked)) {
+            // The deque is full, simply run both the functions.
+            first();
+            second();
+            return;
+        }
+        this->notify();
+        std::exception_ptr error;
+        try {
+            first();
+        } catch (...) {
+            error = std::current_exception();
+        }
+        // Either we get our task back, or we help until the thief is done.
+        while (!forked.is_done()) {
+            detail::pool_task_t *task = this->find_task(deque);
+            if (task != nullptr) {
+                task->execute();
+            } else {
+                std::this_thread::yield();
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        forked.rethrow();
+    }
+
+    /// @brief Submits the function from outside the pool, and waits for it.
+    template <typename Function>
+    void run_root(Function fun) const
+    {
+        detail::function_task_t<Function> root(fun);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            injected.push_back(&root);
+            injected_count.fetch_add(1, std::memory_order_release);
+        }
+        wakeup.notify_one();
+        for (unsigned attempt = 0; !root.is_done(); ++attempt) {
+            if (attempt < 64) {
+                std::this_thread::yield();
+            } else {
+                std::this_thread::sleep_for(std::chrono::microseconds(50));
+            }
+        }
+        root.rethrow();
+    }
+
+    /// @brief Wakes up a sleeping worker, if any.
+    void notify() const
+    {
+        if (sleepers.load(std::memory_order_seq_cst) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wakeup.notify_one();
+        }
+    }
+
+    /// @brief Finds a task: first from its own deque, then from the shared
+    /// queue, and finally by stealing from the other workers.
+    auto find_task(detail::task_deque_t *own) const -> detail::pool_task_t *
+    {
+        detail::pool_task_t *task = own->pop();
+        if (task != nullptr) {
+            return task;
+        }
+        if (injected_count.load(std::memory_order_acquire) > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!injected.empty()) {
+                task = injected.front();
+                injected.pop_front();
+                injected_count.fetch_sub(1, std::memory_order_release);
+                return task;
+            }
+        }
+        for (const std::unique_ptr<detail::task_deque_t> &victim : deques) {
+            if (victim.get() != own) {
+                task = victim->steal();
+                if (task != nullptr) {
+                    return task;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    /// @brief The loop executed by each worker.
+    void worker_loop(std::size_t index)
+    {
+        detail::task_deque_t *own       = deques[index].get();
+        work_stealing_pool_t::current() = std::make_pair(this, own);
+        for (unsigned idle = 0;;) {
+            detail::pool_task_t *task = this->find_task(own);
+            if (task != nullptr) {
+                task->execute();
+                idle = 0;
+            } else if (++idle < 64) {
+                std::this_thread::yield();
+            } else {
+                std::unique_lock<std::mutex> lock(mutex);
+                if (stopping) {
+                    return;
+                }
+                // Sleep for a while, in case a notification gets lost.
+                sleepers.fetch_add(1, std::memory_order_seq_cst);
+                wakeup.wait_for(lock, std::chrono::milliseconds(1));
+                sleepers.fetch_sub(1, std::memory_order_seq_cst);
+            }
+        }
+    }
+
+    /// @brief The workers.
+    std::vector<std::thread> workers;
+    /// @brief The deques of the workers.
+    std::vector<std::unique_ptr<detail::task_deque_t>> deques;
+    /// @brief The tasks submitted from outside the pool.
+    mutable std::deque<detail::pool_task_t *> injected;
+    /// @brief The number of tasks submitted from outside the pool.
+    mutable std::atomic<std::size_t> injected_count;
+    /// @brief The number of sleeping workers.
+    mutable std::atomic<std::size_t> sleepers;
+    /// @brief Protects the shared queue, and the sleeping workers.
+    mutable std::mutex mutex;
+    /// @brief Wakes up the sleeping workers.
+    mutable std::condition_variable wakeup;
+    /// @brief If the pool is stopping.
+    bool stopping;
+};
+
+/// @brief Returns the pool shared by the parallel algorithms which are not
+/// given an executor.
+/// @return a pool with all the hardware threads, started on the first call.
+inline auto default_pool() -> const work_stealing_pool_t &
+{
+    static const work_stealing_pool_t pool;
+    return pool;
+}
+
+} // namespace ordered_map
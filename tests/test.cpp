@@ -6,11 +6,44 @@
 /// See LICENSE.md for details.
 ///
 
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
 #include <iostream>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
+#include "ordered_map/append_only_ordered_map.hpp"
+#include "ordered_map/concurrent_ordered_map.hpp"
+#include "ordered_map/cow_ordered_map.hpp"
+#include "ordered_map/flat_combining_ordered_map.hpp"
+#include "ordered_map/front_coded.hpp"
+#include "ordered_map/json.hpp"
+#include "ordered_map/mvcc_ordered_map.hpp"
 #include "ordered_map/ordered_map.hpp"
+#include "ordered_map/persistent_ordered_map.hpp"
+#include "ordered_map/rcu_ordered_map.hpp"
+#include "ordered_map/seqlock_ordered_map.hpp"
+#include "ordered_map/tiered_ordered_map.hpp"
+#include "ordered_map/tracked_ordered_map.hpp"
+#include "ordered_map/work_stealing_pool.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include "ordered_map/journaled_ordered_map.hpp"
+#include "ordered_map/mapped_ordered_map.hpp"
+#include "ordered_map/shared_ordered_map.hpp"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
 
 using Table = ordered_map::ordered_map_t<std::string, int>;
 
@@ -184,6 +217,1566 @@ auto run_test_4() -> int
     return 0;
 }
 
+auto run_test_5() -> int
+{
+    // Create the table.
+    Table table;
+    // Set the values.
+    table.set("a", 1);
+    table.set("b", 2);
+    table.set("c", 3);
+    table.set("d", 4);
+    table.set("e", 5);
+    // Remove the even values.
+    std::size_t removed = table.erase_if([](const Table::list_entry_t &entry) { return (entry.second % 2) == 0; });
+    if ((removed != 2) || (table.size() != 3)) {
+        std::cerr << "Table size is wrong (after erase_if).\n";
+        return 1;
+    }
+    if (!check(table, "a", 1) || check(table, "b", 2) || !check(table, "c", 3) || check(table, "d", 4) ||
+        !check(table, "e", 5)) {
+        std::cerr << "The key->value association is wrong (after erase_if).\n";
+        return 1;
+    }
+    if (!check(table, 0, 1) || !check(table, 1, 3) || !check(table, 2, 5)) {
+        std::cerr << "The position->value association is wrong (after erase_if).\n";
+        return 1;
+    }
+    // Remove a batch of unsorted keys, including a missing and a duplicated one.
+    std::vector<std::string> keys = {"e", "z", "a", "e"};
+    removed                       = table.erase_keys(keys.begin(), keys.end());
+    if ((removed != 2) || (table.size() != 1)) {
+        std::cerr << "Table size is wrong (after erase_keys).\n";
+        return 1;
+    }
+    if (check(table, "a", 1) || !check(table, "c", 3) || check(table, "e", 5) || !check(table, 0, 3)) {
+        std::cerr << "The key->value association is wrong (after erase_keys).\n";
+        return 1;
+    }
+    return 0;
+}
+
+/// @brief The number of copies allowed before throwing, or a negative value.
+int fragile_budget = -1;
+
+/// @brief A value whose copy throws once the budget is exhausted.
+struct fragile_t {
+    fragile_t() = default;
+
+    fragile_t(const fragile_t &) { fragile_t::spend(); }
+
+    auto operator=(const fragile_t &) -> fragile_t &
+    {
+        fragile_t::spend();
+        return *this;
+    }
+
+    static void spend()
+    {
+        if ((fragile_budget >= 0) && (fragile_budget-- == 0)) {
+            throw std::runtime_error("copy failed");
+        }
+    }
+};
+
+auto run_test_6() -> int
+{
+    // Create the table, and sort it so that the keys do not follow the order.
+    Table table;
+    table.set("c", 1);
+    table.set("a", 2);
+    table.set("b", 3);
+    table.set("d", 4);
+    // Copy it through the copy constructor.
+    Table copy(table);
+    // Change the original, the copy must not be affected.
+    table.set("a", 9);
+    table.erase("d");
+    if (copy.size() != 4) {
+        std::cerr << "Table size is wrong (after copy).\n";
+        return 1;
+    }
+    if (!check(copy, "c", 1) || !check(copy, "a", 2) || !check(copy, "b", 3) || !check(copy, "d", 4)) {
+        std::cerr << "The key->value association is wrong (after copy).\n";
+        return 1;
+    }
+    if (!check(copy, 0, 1) || !check(copy, 1, 2) || !check(copy, 2, 3) || !check(copy, 3, 4)) {
+        std::cerr << "The position->value association is wrong (after copy).\n";
+        return 1;
+    }
+    // The table of the copy must point to its own entries.
+    copy.find("a")->second = 7;
+    if (!check(copy, 1, 7) || !check(table, "a", 9)) {
+        std::cerr << "The copy shares the entries of the original.\n";
+        return 1;
+    }
+    // Assign a smaller table to a larger one.
+    copy = table;
+    if ((copy.size() != 3) || !check(copy, "c", 1) || !check(copy, "a", 9) || !check(copy, "b", 3) ||
+        check(copy, "d", 4) || !check(copy, 0, 1) || !check(copy, 1, 9) || !check(copy, 2, 3)) {
+        std::cerr << "The assignment of a smaller table is wrong.\n";
+        return 1;
+    }
+    // Assign a larger table to a smaller one.
+    table.set("e", 5);
+    table.set("f", 6);
+    copy = table;
+    if ((copy.size() != 5) || !check(copy, "e", 5) || !check(copy, "f", 6) || !check(copy, 4, 6)) {
+        std::cerr << "The assignment of a larger table is wrong.\n";
+        return 1;
+    }
+    copy.erase("e");
+    if ((copy.size() != 4) || (table.size() != 5) || !check(copy, 3, 6)) {
+        std::cerr << "The assigned table shares the entries of the original.\n";
+        return 1;
+    }
+    // A throwing copy must not leave the table pointing at overwritten entries.
+    ordered_map::ordered_map_t<std::string, fragile_t> fragile_source;
+    ordered_map::ordered_map_t<std::string, fragile_t> fragile_target;
+    fragile_source.set("x", fragile_t());
+    fragile_source.set("y", fragile_t());
+    fragile_target.set("y", fragile_t());
+    fragile_target.set("z", fragile_t());
+    fragile_budget = 1;
+    try {
+        fragile_target = fragile_source;
+        std::cerr << "The copy of the element did not throw.\n";
+        return 1;
+    } catch (const std::runtime_error &) {
+        // Expected.
+    }
+    fragile_budget = -1;
+    fragile_target.set("x", fragile_t());
+    if ((fragile_target.size() != 1) || (fragile_target.find("y") != fragile_target.end())) {
+        std::cerr << "A failed assignment left the table inconsistent.\n";
+        return 1;
+    }
+    return 0;
+}
+
+auto run_test_7() -> int
+{
+    // Create the shared table.
+    ordered_map::cow_ordered_map_t<std::string, int> original;
+    original.set("a", 1);
+    original.set("b", 2);
+    // Copying the handle must only share the table.
+    ordered_map::cow_ordered_map_t<std::string, int> snapshot(original);
+    if (!original.is_shared() || (&original.get() != &snapshot.get())) {
+        std::cerr << "The copy did not share the table.\n";
+        return 1;
+    }
+    // Reading and erasing missing keys must not detach.
+    snapshot.erase("z");
+    if (!check(snapshot.get(), "a", 1) || (&original.get() != &snapshot.get())) {
+        std::cerr << "Reading detached the table.\n";
+        return 1;
+    }
+    // The first mutation must detach the handle.
+    original.set("c", 3);
+    original.set("a", 4);
+    if (snapshot.is_shared() || (&original.get() == &snapshot.get())) {
+        std::cerr << "The mutation did not detach the table.\n";
+        return 1;
+    }
+    if ((snapshot.size() != 2) || !check(snapshot.get(), "a", 1) || check(snapshot.get(), "c", 3)) {
+        std::cerr << "The mutation changed the snapshot.\n";
+        return 1;
+    }
+    if ((original.size() != 3) || !check(original.get(), "a", 4) || !check(original.get(), 2, 3)) {
+        std::cerr << "The mutation was not applied.\n";
+        return 1;
+    }
+    // Once a copy used by another thread is gone, the map is modified in place.
+    const ordered_map::cow_ordered_map_t<std::string, int>::map_t *address = &original.get();
+    std::size_t seen = 0;
+    std::thread reader([&seen](ordered_map::cow_ordered_map_t<std::string, int> copy) { seen = copy.size(); },
+                       original);
+    while (original.is_shared()) {
+        std::this_thread::yield();
+    }
+    original.set("d", 5);
+    reader.join();
+    snapshot = original;
+    snapshot = std::move(original);
+    if ((&snapshot.get() != address) || (snapshot.size() != 4) || (seen != 3) || (snapshot.use_count() != 1)) {
+        std::cerr << "The handle was not released by the other thread.\n";
+        return 1;
+    }
+    return 0;
+}
+
+auto run_test_8() -> int
+{
+    using Persistent = ordered_map::persistent_ordered_map_t<std::string, int>;
+    // Build a sequence of versions.
+    Persistent v0;
+    Persistent v1 = v0.set("c", 1).set("a", 2).set("b", 3);
+    Persistent v2 = v1.set("a", 4).erase("c").set("d", 5);
+    if ((v0.size() != 0) || (v1.size() != 3) || (v2.size() != 3)) {
+        std::cerr << "The size of the versions is wrong.\n";
+        return 1;
+    }
+    // The old version must be unchanged.
+    if ((v1.find("a")->second != 2) || (v1.find("c") == v1.end()) || (v1.at(0)->second != 1)) {
+        std::cerr << "The old version was modified.\n";
+        return 1;
+    }
+    // The new version must follow the insertion order.
+    if ((v2.find("a")->second != 4) || (v2.find("c") != v2.end()) || (v2.at(0)->first != "a") ||
+        (v2.at(1)->first != "b") || (v2.at(2)->first != "d") || (v2.at(3) != v2.end())) {
+        std::cerr << "The new version is wrong.\n";
+        return 1;
+    }
+    // Compare a long batch of modifications against the ordered map.
+    Table reference;
+    Persistent::transient_t transient = v0.transient();
+    std::vector<Persistent> versions;
+    unsigned seed = 7;
+    for (int step = 0; step < 2000; ++step) {
+        seed            = (seed * 1103515245U) + 12345U;
+        std::string key = std::to_string((seed >> 8U) % 97U);
+        if (((seed >> 4U) % 4U) == 0) {
+            reference.erase(key);
+            transient.erase(key);
+        } else {
+            reference.set(key, step);
+            transient.set(key, step);
+        }
+        if ((step % 100) == 0) {
+            versions.push_back(transient.persistent());
+        }
+    }
+    Persistent last = transient.persistent();
+    if (last.size() != reference.size()) {
+        std::cerr << "The size of the transient is wrong.\n";
+        return 1;
+    }
+    Persistent::const_iterator it = last.begin();
+    for (const auto &entry : reference) {
+        if ((it == last.end()) || (it->first != entry.first) || (it->second != entry.second) ||
+            (last.find(entry.first)->second != entry.second)) {
+            std::cerr << "The content of the transient is wrong.\n";
+            return 1;
+        }
+        ++it;
+    }
+    // Modifying the transient must not change the returned versions.
+    transient.set("a", -1);
+    if ((last.find("a") != last.end()) || (versions[0].size() != 1)) {
+        std::cerr << "The transient modified a persistent version.\n";
+        return 1;
+    }
+    return 0;
+}
+
+auto run_test_9() -> int
+{
+    ordered_map::concurrent_ordered_map_t<std::string, int> table(8);
+    // Each thread inserts its own keys, in increasing order.
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&table, thread]() {
+            for (int index = 0; index < 1000; ++index) {
+                table.set(std::to_string(thread) + "." + std::to_string(index), index);
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    // Update and remove a few keys.
+    table.set("0.10", -1);
+    table.erase("1.10");
+    int value = 0;
+    if ((table.size() != 3999) || !table.find("0.10", value) || (value != -1) || table.contains("1.10")) {
+        std::cerr << "The content of the concurrent map is wrong.\n";
+        return 1;
+    }
+    // The merged view must preserve the insertion order of each thread.
+    Table merged = table.snapshot();
+    std::vector<int> last(4, -1);
+    for (const auto &entry : merged) {
+        auto thread = static_cast<std::size_t>(entry.first[0] - '0');
+        int index   = std::stoi(entry.first.substr(2));
+        if (index <= last[thread]) {
+            std::cerr << "The merged view does not follow the insertion order.\n";
+            return 1;
+        }
+        last[thread] = index;
+    }
+    if ((merged.size() != 3999) || !check(merged, "0.10", -1)) {
+        std::cerr << "The merged view is wrong.\n";
+        return 1;
+    }
+    return 0;
+}
+
+auto run_test_10() -> int
+{
+    ordered_map::rcu_ordered_map_t<std::string, int> table;
+    table.update([](Table &map) {
+        map.set("a", 0);
+        map.set("b", 0);
+        map.set("c", 0);
+    });
+    // The readers must always see all the values of the same version.
+    std::atomic<bool> done(false);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> readers;
+    for (int thread = 0; thread < 3; ++thread) {
+        readers.emplace_back([&table, &done, &errors]() {
+            auto reader = table.make_reader();
+            while (!done.load()) {
+                auto view = reader.read();
+                int value = view->find("a")->second;
+                if ((view->size() != 3) || !check(*view, "b", value) || !check(*view, 2, value)) {
+                    ++errors;
+                }
+            }
+        });
+    }
+    for (int version = 1; version <= 500; ++version) {
+        table.update([version](Table &map) {
+            map.set("a", version);
+            map.set("b", version);
+            map.set("c", version);
+        });
+    }
+    done.store(true);
+    for (std::thread &thread : readers) {
+        thread.join();
+    }
+    if (errors.load() != 0) {
+        std::cerr << "A reader saw an inconsistent version.\n";
+        return 1;
+    }
+    // Without active readers, all the old versions can be deleted.
+    table.erase("c");
+    if (table.reclaim() != 0) {
+        std::cerr << "The old versions were not reclaimed.\n";
+        return 1;
+    }
+    auto reader = table.make_reader();
+    auto view   = reader.read();
+    if ((view->size() != 2) || !check(*view, "a", 500)) {
+        std::cerr << "The last version is wrong.\n";
+        return 1;
+    }
+    return 0;
+}
+
+auto run_test_11() -> int
+{
+    // The two halves of a value are always written together.
+    struct pair_t {
+        std::uint64_t first;
+        std::uint64_t second;
+    };
+    ordered_map::seqlock_ordered_map_t<int, pair_t> table(64);
+    for (int key = 0; key < 10; ++key) {
+        table.set(key, pair_t{0, 0});
+    }
+    // Check erase and the insertion order.
+    table.erase(3);
+    table.set(3, pair_t{0, 0});
+    int key      = 0;
+    pair_t value = {};
+    if ((table.size() != 10) || !table.at(9, key, value) || (key != 3) || !table.at(3, key, value) || (key != 4)) {
+        std::cerr << "The order of the seqlock map is wrong.\n";
+        return 1;
+    }
+    // Readers must never see a torn value.
+    std::atomic<bool> done(false);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> readers;
+    for (int thread = 0; thread < 3; ++thread) {
+        readers.emplace_back([&table, &done, &errors]() {
+            pair_t read = {};
+            while (!done.load()) {
+                if (!table.find(5, read) || (read.first != read.second)) {
+                    ++errors;
+                }
+            }
+        });
+    }
+    for (std::uint64_t version = 1; version <= 20000; ++version) {
+        table.set(5, pair_t{version, version});
+        if ((version % 100) == 0) {
+            table.erase(1);
+            table.set(1, pair_t{version, version});
+        }
+    }
+    done.store(true);
+    for (std::thread &thread : readers) {
+        thread.join();
+    }
+    if ((errors.load() != 0) || !table.find(5, value) || (value.first != 20000)) {
+        std::cerr << "A reader saw a torn value.\n";
+        return 1;
+    }
+    return 0;
+}
+
+auto run_test_12() -> int
+{
+    ordered_map::append_only_ordered_map_t<std::string, int> table(4096);
+    // Check the insertion order.
+    table.set("c", 1);
+    table.set("a", 2);
+    table.set("c", 3);
+    std::string order;
+    table.for_each([&order](const std::string &key, int value) { order += key + std::to_string(value); });
+    if ((table.size() != 2) || (order != "c3a2")) {
+        std::cerr << "The order of the append-only map is wrong.\n";
+        return 1;
+    }
+    // All threads append the same keys, each key must appear once.
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&table]() {
+            for (int index = 0; index < 500; ++index) {
+                table.set("k" + std::to_string(index), index);
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    std::size_t visited = 0;
+    int errors          = 0;
+    table.for_each([&visited, &errors](const std::string &key, int value) {
+        ++visited;
+        if ((key[0] == 'k') && (std::to_string(value) != key.substr(1))) {
+            ++errors;
+        }
+    });
+    int value = 0;
+    if ((table.size() != 502) || (visited != 502) || (errors != 0) || !table.find("k42", value) || (value != 42)) {
+        std::cerr << "The content of the append-only map is wrong.\n";
+        return 1;
+    }
+    return 0;
+}
+
+auto run_test_13() -> int
+{
+    ordered_map::flat_combining_ordered_map_t<std::string, int> table;
+    // Each thread inserts its own keys, and reads them back.
+    std::atomic<int> errors(0);
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&table, &errors, thread]() {
+            auto handle = table.make_handle();
+            for (int index = 0; index < 1000; ++index) {
+                std::string key = std::to_string(thread) + "." + std::to_string(index);
+                int value       = -1;
+                if (!handle.set(key, index) || !handle.find(key, value) || (value != index)) {
+                    ++errors;
+                }
+                if (((index % 10) == 0) && !handle.erase(key)) {
+                    ++errors;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    if ((errors.load() != 0) || (table.unsafe_map().size() != 3600)) {
+        std::cerr << "The content of the flat-combining map is wrong.\n";
+        return 1;
+    }
+    // Every operation must be accounted inside the histogram.
+    std::vector<std::size_t> histogram = table.batch_histogram();
+    std::size_t batches                = 0;
+    for (std::size_t count : histogram) {
+        batches += count;
+    }
+    if ((batches == 0) || (batches > 4 * 2100)) {
+        std::cerr << "The batch histogram is wrong.\n";
+        return 1;
+    }
+    return 0;
+}
+
+auto run_test_14() -> int
+{
+    // Build an input with many duplicated keys.
+    std::vector<std::pair<std::string, int>> input;
+    unsigned seed = 11;
+    for (int index = 0; index < 50000; ++index) {
+        seed = (seed * 1103515245U) + 12345U;
+        input.emplace_back(std::to_string((seed >> 8U) % 20000U), index);
+    }
+    // The reference is built with repeated calls to set.
+    Table reference;
+    for (const auto &entry : input) {
+        reference.set(entry.first, entry.second);
+    }
+    Table parallel   = Table::parallel_build(input.begin(), input.end(), ordered_map::thread_executor_t(4));
+    Table sequential = Table::parallel_build(input.begin(), input.end(), ordered_map::sequential_executor_t());
+    for (const Table *table : {&parallel, &sequential}) {
+        if (table->size() != reference.size()) {
+            std::cerr << "The size of the parallel build is wrong.\n";
+            return 1;
+        }
+        Table::const_iterator it = table->begin();
+        for (const auto &entry : reference) {
+            if ((it->first != entry.first) || (it->second != entry.second) || !check(*table, entry.first, entry.second)) {
+                std::cerr << "The content of the parallel build is wrong.\n";
+                return 1;
+            }
+            ++it;
+        }
+    }
+    return 0;
+}
+
+auto run_test_15() -> int
+{
+    // Build a table with many ties between the values.
+    Table table;
+    unsigned seed = 3;
+    for (int index = 0; index < 30000; ++index) {
+        seed = (seed * 1103515245U) + 12345U;
+        table.set(std::to_string(index), static_cast<int>((seed >> 8U) % 1000U));
+    }
+    auto by_value = [](const Table::list_entry_t &lhs, const Table::list_entry_t &rhs) {
+        return lhs.second < rhs.second;
+    };
+    // The reference uses the sequential (stable) sort.
+    Table reference(table);
+    reference.sort([](const Table::list_entry_t &lhs, const Table::list_entry_t &rhs) {
+        return lhs.second < rhs.second;
+    });
+    Table sorted(table);
+    sorted.parallel_sort(by_value, ordered_map::thread_executor_t(3));
+    if (sorted.size() != reference.size()) {
+        std::cerr << "The size of the sorted table is wrong.\n";
+        return 1;
+    }
+    Table::const_iterator it = sorted.begin();
+    for (const auto &entry : reference) {
+        if ((it->first != entry.first) || !check(sorted, entry.first, entry.second)) {
+            std::cerr << "The order of the sorted table is wrong.\n";
+            return 1;
+        }
+        ++it;
+    }
+    return 0;
+}
+
+auto run_test_16() -> int
+{
+    using Doubles = ordered_map::ordered_map_t<int, double>;
+    Doubles table;
+    for (int index = 0; index < 20000; ++index) {
+        table.set(index, 1.0 / (index + 1));
+    }
+    // Scale all the values, then double them.
+    table.parallel_for_each([](Doubles::list_entry_t &entry) { entry.second *= 3.0; }, ordered_map::thread_executor_t(4));
+    table.parallel_transform_values(
+        [](const Doubles::list_entry_t &entry) { return entry.second * 2.0; }, ordered_map::thread_executor_t(4));
+    if ((table.find(0)->second < 5.999) || (table.find(0)->second > 6.001) || (table.at(19999)->first != 19999)) {
+        std::cerr << "The parallel transformation is wrong.\n";
+        return 1;
+    }
+    // The reduction must give the same result with any number of threads.
+    auto value = [](const Doubles::list_entry_t &entry) { return entry.second; };
+    auto sum   = [](double lhs, double rhs) { return lhs + rhs; };
+    double one = table.parallel_reduce(0.0, value, sum, ordered_map::sequential_executor_t());
+    double two = table.parallel_reduce(0.0, value, sum, ordered_map::thread_executor_t(2));
+    double six = table.parallel_reduce(0.0, value, sum, ordered_map::thread_executor_t(6));
+    if ((std::memcmp(&one, &two, sizeof(double)) != 0) || (std::memcmp(&one, &six, sizeof(double)) != 0)) {
+        std::cerr << "The parallel reduction is not deterministic.\n";
+        return 1;
+    }
+    if ((one < 6.0 * 10.0) || (one > 6.0 * 11.0)) {
+        std::cerr << "The parallel reduction is wrong.\n";
+        return 1;
+    }
+    return 0;
+}
+
+auto fibonacci(const ordered_map::work_stealing_pool_t &pool, int value) -> long
+{
+    if (value < 12) {
+        return (value < 2) ? value : (fibonacci(pool, value - 1) + fibonacci(pool, value - 2));
+    }
+    long lhs = 0;
+    long rhs = 0;
+    pool.invoke([&pool, &lhs, value]() { lhs = fibonacci(pool, value - 1); }, [&pool, &rhs, value]() {
+        rhs = fibonacci(pool, value - 2);
+    });
+    return lhs + rhs;
+}
+
+auto run_test_17() -> int
+{
+    ordered_map::work_stealing_pool_t pool(4);
+    // Nested fork-join.
+    if (fibonacci(pool, 24) != 46368) {
+        std::cerr << "The fork-join invoke is wrong.\n";
+        return 1;
+    }
+    // Each index must be visited exactly once.
+    std::vector<std::atomic<int>> visits(100000);
+    pool.parallel_for(visits.size(), [&visits](std::size_t index) { ++visits[index]; });
+    for (const std::atomic<int> &visit : visits) {
+        if (visit.load() != 1) {
+            std::cerr << "The parallel for is wrong.\n";
+            return 1;
+        }
+    }
+    // Exceptions must reach the caller.
+    bool thrown = false;
+    try {
+        pool.parallel_for(1000, [](std::size_t index) {
+            if (index == 500) {
+                throw std::runtime_error("failure");
+            }
+        });
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    if (!thrown) {
+        std::cerr << "The exception was lost.\n";
+        return 1;
+    }
+    // The pool can drive the parallel algorithms of the map.
+    Table table;
+    for (int index = 0; index < 20000; ++index) {
+        table.set(std::to_string(index), 20000 - index);
+    }
+    table.parallel_sort(
+        [](const Table::list_entry_t &lhs, const Table::list_entry_t &rhs) { return lhs.second < rhs.second; }, pool);
+    long sum = table.parallel_reduce(
+        0L, [](const Table::list_entry_t &entry) { return static_cast<long>(entry.second); },
+        [](long lhs, long rhs) { return lhs + rhs; }, pool);
+    if (!check(table, 0, 1) || !check(table, 19999, 20000) || (sum != 200010000L)) {
+        std::cerr << "The parallel algorithms are wrong with the pool.\n";
+        return 1;
+    }
+    // Without an executor, they use the default pool.
+    table.parallel_transform_values([](const Table::list_entry_t &entry) { return entry.second * 2; });
+    sum = table.parallel_reduce(
+        0L, [](const Table::list_entry_t &entry) { return static_cast<long>(entry.second); },
+        [](long lhs, long rhs) { return lhs + rhs; });
+    if (!check(table, 0, 2) || (sum != 400020000L) || (ordered_map::default_pool().concurrency() == 0)) {
+        std::cerr << "The parallel algorithms are wrong with the default pool.\n";
+        return 1;
+    }
+    return 0;
+}
+
+auto run_test_18() -> int
+{
+    using Mvcc = ordered_map::mvcc_ordered_map_t<std::string, int>;
+    Mvcc map;
+    map.set("a", 1);
+    map.set("b", 2);
+    map.set("c", 3);
+    Mvcc::snapshot_t before = map.snapshot();
+    map.set("b", 20);
+    map.erase("a");
+    map.set("a", 10);
+    map.set("d", 4);
+    // The snapshot ignores the later changes.
+    std::string keys;
+    int sum = 0;
+    for (Mvcc::const_iterator it = before.begin(); it != before.end(); ++it) {
+        keys += it.key();
+        sum += it.value();
+    }
+    int value = 0;
+    if ((keys != "abc") || (sum != 6) || !before.find("b", value) || (value != 2) || before.find("d", value)) {
+        std::cerr << "The snapshot sees later changes.\n";
+        return 1;
+    }
+    // The current version sees them, with the re-inserted key at the end.
+    {
+        Mvcc::snapshot_t after = map.snapshot();
+        keys.clear();
+        for (Mvcc::const_iterator it = after.begin(); it != after.end(); ++it) {
+            keys += it.key();
+        }
+        if ((keys != "bcad") || !map.find("a", value) || (value != 10) || (map.size() != 4)) {
+            std::cerr << "The current version is wrong.\n";
+            return 1;
+        }
+    }
+    // Old versions are kept while the snapshot is alive, then reclaimed.
+    map.collect();
+    if (map.footprint() != std::make_pair<std::size_t, std::size_t>(5, 6)) {
+        std::cerr << "The versions seen by the snapshot were reclaimed.\n";
+        return 1;
+    }
+    { Mvcc::snapshot_t released(std::move(before)); }
+    map.collect();
+    if (map.footprint() != std::make_pair<std::size_t, std::size_t>(4, 4)) {
+        std::cerr << "The unreachable versions were not reclaimed.\n";
+        return 1;
+    }
+    // A long chain of versions is reclaimed, and destroyed, without recursion.
+    {
+        Mvcc chain;
+        // Other keys keep the incremental reclamation away from the long chain.
+        for (int index = 0; index < 40000; ++index) {
+            chain.set("cold" + std::to_string(index), index);
+        }
+        for (int round = 0; round < 2; ++round) {
+            Mvcc::snapshot_t pinned = chain.snapshot();
+            for (int index = 0; index < 1000000; ++index) {
+                chain.set("hot", index);
+            }
+            if (round == 0) {
+                { Mvcc::snapshot_t released(std::move(pinned)); }
+                chain.collect();
+                if (chain.footprint() != std::make_pair<std::size_t, std::size_t>(40001, 40001)) {
+                    std::cerr << "The chain of versions was not reclaimed.\n";
+                    return 1;
+                }
+            }
+        }
+    }
+    // Readers iterate consistent views while a writer keeps modifying the map.
+    Mvcc shared;
+    for (int index = 0; index < 100; ++index) {
+        shared.set(std::to_string(index), 0);
+    }
+    const std::uint64_t base = shared.version();
+    std::atomic<bool> stop(false);
+    std::thread writer([&shared, &stop]() {
+        // Each round moves a key to the end, setting its value to the round.
+        for (int round = 1; !stop.load(); ++round) {
+            shared.erase(std::to_string(round % 100));
+            shared.set(std::to_string(round % 100), round);
+        }
+    });
+    bool consistent = true;
+    for (int read = 0; read < 200; ++read) {
+        Mvcc::snapshot_t view = shared.snapshot();
+        long total            = 0;
+        std::size_t count     = 0;
+        for (Mvcc::const_iterator it = view.begin(); it != view.end(); ++it) {
+            total += it.value();
+            ++count;
+        }
+        // The content is fully determined by the version of the snapshot.
+        const long rounds = static_cast<long>((view.version() - base) / 2);
+        const bool middle = ((view.version() - base) % 2) != 0;
+        long expected     = 0;
+        for (long round = std::max(rounds - 99, 1L); round <= rounds; ++round) {
+            expected += round;
+        }
+        if (middle) {
+            expected -= (rounds + 1 > 100) ? rounds + 1 - 100 : 0;
+        }
+        consistent = consistent && (total == expected) && (count == (middle ? 99U : 100U));
+    }
+    stop = true;
+    writer.join();
+    if (!consistent) {
+        std::cerr << "A snapshot was not consistent.\n";
+        return 1;
+    }
+    return 0;
+}
+
+/// @brief A user type, serialized with a custom codec.
+struct tag_t {
+    std::string name;
+    int weight;
+};
+
+namespace ordered_map
+{
+template <>
+struct codec_t<tag_t> {
+    static void encode(std::ostream &stream, const tag_t &value)
+    {
+        codec_t<std::string>::encode(stream, value.name);
+        codec_t<int>::encode(stream, value.weight);
+    }
+
+    static void decode(std::istream &stream, tag_t &value)
+    {
+        codec_t<std::string>::decode(stream, value.name);
+        codec_t<int>::decode(stream, value.weight);
+    }
+};
+} // namespace ordered_map
+
+auto run_test_19() -> int
+{
+    // Strings go through their codec, and the order is preserved.
+    Table table;
+    for (int index = 0; index < 1000; ++index) {
+        table.set(std::to_string((index * 7919) % 1000), index);
+    }
+    std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
+    table.save(stream);
+    Table loaded;
+    loaded.set("stale", 0);
+    loaded.load(stream);
+    if ((loaded.size() != table.size()) || !std::equal(table.begin(), table.end(), loaded.begin()) ||
+        !check(loaded, "919", 1) || (loaded.find("stale") != loaded.end())) {
+        std::cerr << "The loaded map is different.\n";
+        return 1;
+    }
+    // Trivially copyable entries are copied in blocks.
+    ordered_map::ordered_map_t<int, double> raw;
+    for (int index = 0; index < 20000; ++index) {
+        raw.set(20000 - index, index * 0.5);
+    }
+    std::stringstream raw_stream(std::ios::in | std::ios::out | std::ios::binary);
+    raw.save(raw_stream);
+    if (raw_stream.str().size() != 32 + (20000 * (sizeof(int) + sizeof(double)))) {
+        std::cerr << "The raw entries are not stored compactly.\n";
+        return 1;
+    }
+    ordered_map::ordered_map_t<int, double> raw_loaded;
+    raw_loaded.load(raw_stream);
+    if (!std::equal(raw.begin(), raw.end(), raw_loaded.begin()) || (raw_loaded.find(1)->second < 9999.5) ||
+        (raw_loaded.find(1)->second > 9999.5)) {
+        std::cerr << "The loaded raw map is different.\n";
+        return 1;
+    }
+    // Custom codecs.
+    ordered_map::ordered_map_t<std::string, tag_t> tags;
+    tags.set("b", tag_t{"bravo", 2});
+    tags.set("a", tag_t{"alpha", 1});
+    std::stringstream tag_stream(std::ios::in | std::ios::out | std::ios::binary);
+    tags.save(tag_stream);
+    ordered_map::ordered_map_t<std::string, tag_t> tags_loaded;
+    tags_loaded.load(tag_stream);
+    if ((tags_loaded.begin()->first != "b") || (tags_loaded.find("a")->second.name != "alpha") ||
+        (tags_loaded.find("b")->second.weight != 2)) {
+        std::cerr << "The custom codec was not used.\n";
+        return 1;
+    }
+    // Invalid streams are rejected, leaving the map untouched.
+    std::string bytes = stream.str();
+    const std::string broken[] = {bytes.substr(0, bytes.size() - 1), "XMAP" + bytes.substr(4), raw_stream.str()};
+    for (const std::string &data : broken) {
+        std::stringstream input(data, std::ios::in | std::ios::binary);
+        bool thrown = false;
+        try {
+            loaded.load(input);
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        if (!thrown || (loaded.size() != table.size())) {
+            std::cerr << "An invalid stream was accepted.\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+auto run_test_20() -> int
+{
+#if defined(__unix__) || defined(__APPLE__)
+    using Mapped = ordered_map::mapped_ordered_map_t<std::string, int>;
+    Table table;
+    for (int index = 0; index < 5000; ++index) {
+        table.set(std::to_string((index * 7919) % 5000), index);
+    }
+    const std::string path = "ordered_map_test_20.snapshot";
+    Mapped::write_snapshot(table, path);
+    {
+        Mapped mapped(path);
+        // Iteration follows the insertion order.
+        Table::const_iterator it_table = table.begin();
+        for (Mapped::const_iterator it = mapped.begin(); it != mapped.end(); ++it, ++it_table) {
+            if ((it.key() != it_table->first) || (it.value() != it_table->second)) {
+                std::cerr << "The mapped iteration is wrong.\n";
+                return 1;
+            }
+        }
+        Mapped::const_iterator found = mapped.find("2919");
+        if ((mapped.size() != 5000) || (found == mapped.end()) || (found.value() != 1) ||
+            (mapped.find("5000") != mapped.end()) || (mapped.at(2).key().str() != "838") ||
+            (mapped.at(5000) != mapped.end())) {
+            std::cerr << "The mapped lookup is wrong.\n";
+            return 1;
+        }
+        // The mapping survives the replacement of the file.
+        table.set("new", -1);
+        Mapped::write_snapshot(table, path);
+        if ((mapped.size() != 5000) || (mapped.find("2919").value() != 1)) {
+            std::cerr << "The mapping was changed by a new snapshot.\n";
+            return 1;
+        }
+        Mapped replaced(path);
+        if ((replaced.size() != 5001) || (replaced.find("new").value() != -1)) {
+            std::cerr << "The new snapshot is wrong.\n";
+            return 1;
+        }
+    }
+    // Trivially copyable values are accessed in place, and types are checked.
+    ordered_map::ordered_map_t<int, double> raw;
+    raw.set(3, 1.5);
+    raw.set(1, 2.5);
+    ordered_map::mapped_ordered_map_t<int, double>::write_snapshot(raw, path);
+    bool thrown = false;
+    try {
+        Mapped wrong(path);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    ordered_map::mapped_ordered_map_t<int, double> mapped_raw(path);
+    std::remove(path.c_str());
+    if (!thrown || (mapped_raw.begin().key() != 3) || (mapped_raw.find(1).value() < 2.5) ||
+        (mapped_raw.find(1).value() > 2.5)) {
+        std::cerr << "The mapped raw snapshot is wrong.\n";
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+auto run_test_21() -> int
+{
+    using Object = ordered_map::ordered_map_t<std::string, int>;
+    using Nested = ordered_map::ordered_map_t<std::string, Object>;
+    // Keys keep the order of the document, and duplicates keep the last value.
+    std::stringstream input(" { \"z\" : {\"b\":1, \"a\":-2}, \"y\":{}, \"x\":{\"c\":3,\"b\":4,\"c\":5} } ");
+    Nested nested;
+    ordered_map::read_json(input, nested);
+    if ((nested.size() != 3) || (nested.at(0)->first != "z") || (nested.at(1)->first != "y") ||
+        (nested.find("z")->second.at(1)->first != "a") || (nested.find("x")->second.size() != 2) ||
+        (nested.find("x")->second.find("c")->second != 5) || (nested.find("x")->second.at(0)->first != "c")) {
+        std::cerr << "The JSON object was not read in order.\n";
+        return 1;
+    }
+    // Writing follows the insertion order, and reading it back is lossless.
+    ordered_map::json_writer_t writer;
+    if (writer.write(nested) != "{\"z\":{\"b\":1,\"a\":-2},\"y\":{},\"x\":{\"c\":5,\"b\":4}}") {
+        std::cerr << "The JSON object was not written in order.\n";
+        return 1;
+    }
+    // Strings, escapes and arrays.
+    using Texts = ordered_map::ordered_map_t<std::string, std::vector<std::string>>;
+    Texts texts;
+    texts.set("quote\"d", {"tab\there", "line\nbreak", "\x01"});
+    texts.set("unicode", {"\xC3\xA8", "\xF0\x9F\x98\x80"});
+    std::stringstream text_stream;
+    ordered_map::write_json(text_stream, texts);
+    Texts texts_loaded;
+    ordered_map::read_json(text_stream, texts_loaded);
+    std::stringstream escaped("{\"unicode\":[\"\\u00e8\",\"\\ud83d\\ude00\"]}");
+    Texts escaped_loaded;
+    ordered_map::read_json(escaped, escaped_loaded);
+    if (!std::equal(texts.begin(), texts.end(), texts_loaded.begin()) ||
+        (escaped_loaded.find("unicode")->second != texts.find("unicode")->second)) {
+        std::cerr << "The JSON strings were not decoded correctly.\n";
+        return 1;
+    }
+    // Numbers round-trip exactly.
+    ordered_map::ordered_map_t<std::string, double> numbers;
+    numbers.set("third", 1.0 / 3.0);
+    numbers.set("large", -1.5e300);
+    std::stringstream number_stream;
+    ordered_map::write_json(number_stream, numbers);
+    ordered_map::ordered_map_t<std::string, double> numbers_loaded;
+    ordered_map::read_json(number_stream, numbers_loaded);
+    if (std::memcmp(&numbers.find("third")->second, &numbers_loaded.find("third")->second, sizeof(double)) != 0 ||
+        std::memcmp(&numbers.find("large")->second, &numbers_loaded.find("large")->second, sizeof(double)) != 0) {
+        std::cerr << "The JSON numbers do not round-trip.\n";
+        return 1;
+    }
+    // Numbers which overflow a double are rejected.
+    std::stringstream overflow_stream("{\"a\":1e999}");
+    bool overflow_thrown = false;
+    try {
+        ordered_map::read_json(overflow_stream, numbers_loaded);
+    } catch (const ordered_map::json_error_t &) {
+        overflow_thrown = true;
+    }
+    if (!overflow_thrown || (numbers_loaded.size() != 2)) {
+        std::cerr << "A JSON number out of range was accepted.\n";
+        return 1;
+    }
+    // Invalid documents are rejected, leaving the map untouched.
+    const char *invalid[] = {"{\"a\":1,}", "{\"a\":1.5}", "{\"a\":99999999999}", "{\"a\":01}", "{\"a\" 1}",
+                             "{\"a\":1} x", "{\"a\":\"b\"}", "{\"a\":1"};
+    Object object;
+    object.set("kept", 1);
+    for (const char *document : invalid) {
+        std::stringstream stream(document);
+        bool thrown = false;
+        try {
+            ordered_map::read_json(stream, object);
+        } catch (const ordered_map::json_error_t &) {
+            thrown = true;
+        }
+        if (!thrown || (object.size() != 1)) {
+            std::cerr << "An invalid JSON document was accepted: " << document << "\n";
+            return 1;
+        }
+    }
+    return 0;
+}
+
+auto run_test_22() -> int
+{
+#if defined(__unix__) || defined(__APPLE__)
+    using Journaled        = ordered_map::journaled_ordered_map_t<std::string, int>;
+    const std::string path = "ordered_map_test_22";
+    auto cleanup           = [&path]() {
+        for (const char *suffix : {".snapshot", ".snapshot.tmp", ".log", ".log.old"}) {
+            std::remove((path + suffix).c_str());
+        }
+    };
+    cleanup();
+    Journaled::options_t options;
+    options.compaction_threshold = 4096;
+    {
+        Journaled journaled(path, options);
+        for (int index = 0; index < 100; ++index) {
+            journaled.set(std::to_string(index), index);
+        }
+        journaled.erase("50");
+        journaled.sort(
+            [](const Table::list_entry_t &lhs, const Table::list_entry_t &rhs) { return lhs.second > rhs.second; });
+        journaled.set("99", -99);
+    }
+    // Recovery replays the snapshot and the log, including the order.
+    auto verify = [&path, &options](std::size_t expected) -> bool {
+        Journaled journaled(path, options);
+        Table table = journaled.copy();
+        int value   = 0;
+        return (table.size() == expected) && check(table, 0, -99) && check(table, 1, 98) &&
+               !journaled.find("50", value) && journaled.find("0", value) && (value == 0);
+    };
+    if (!verify(99)) {
+        std::cerr << "The journal was not recovered.\n";
+        return 1;
+    }
+    // A record torn by a crash is discarded, and the journal keeps working.
+    {
+        std::ofstream log((path + ".log").c_str(), std::ios::out | std::ios::binary | std::ios::app);
+        log.write("\x20\x00\x00\x00garbage", 11);
+    }
+    {
+        Journaled journaled(path, options);
+        journaled.set("new", 1);
+    }
+    if (!verify(100)) {
+        std::cerr << "The torn record was not discarded.\n";
+        return 1;
+    }
+    // Compaction moves everything into the snapshot.
+    {
+        Journaled journaled(path, options);
+        journaled.compact();
+        if (journaled.log_size() != 0) {
+            std::cerr << "The log was not compacted.\n";
+            return 1;
+        }
+        journaled.erase("new");
+    }
+    if (!verify(99)) {
+        std::cerr << "The compacted journal was not recovered.\n";
+        return 1;
+    }
+    // Concurrent writers are committed in groups, while compactions run in background.
+    {
+        Journaled journaled(path, options);
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < 4; ++thread) {
+            threads.emplace_back([&journaled, thread]() {
+                for (int index = 0; index < 200; ++index) {
+                    journaled.set("t" + std::to_string(thread) + "_" + std::to_string(index), index);
+                }
+            });
+        }
+        for (std::thread &thread : threads) {
+            thread.join();
+        }
+    }
+    if (!verify(899)) {
+        std::cerr << "The concurrent writes were not recovered.\n";
+        return 1;
+    }
+    // A log with a missing record is rejected.
+    cleanup();
+    {
+        Journaled journaled(path);
+        journaled.set("a", 1);
+        journaled.set("b", 2);
+        journaled.set("c", 3);
+    }
+    {
+        std::ifstream input((path + ".log").c_str(), std::ios::in | std::ios::binary);
+        std::ostringstream buffer(std::ios::out | std::ios::binary);
+        buffer << input.rdbuf();
+        std::string log = buffer.str();
+        std::uint32_t length = 0;
+        std::memcpy(&length, &log[0], sizeof(length));
+        std::uint32_t second = 0;
+        std::memcpy(&second, &log[8 + length], sizeof(second));
+        log.erase(8 + length, 8 + second);
+        std::ofstream output((path + ".log").c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        output.write(log.data(), static_cast<std::streamsize>(log.size()));
+    }
+    bool gap_thrown = false;
+    try {
+        Journaled journaled(path);
+    } catch (const std::runtime_error &) {
+        gap_thrown = true;
+    }
+    if (!gap_thrown) {
+        std::cerr << "A log with a missing record was accepted.\n";
+        return 1;
+    }
+    cleanup();
+#endif
+    return 0;
+}
+
+auto run_test_23() -> int
+{
+    using Tracked = ordered_map::tracked_ordered_map_t<std::string, int>;
+    Tracked source;
+    Table replicas[2];
+    std::uint64_t cursors[2] = {0, 0};
+    // Ships the changes to a replica through a stream, as another process would.
+    auto sync = [&source, &replicas, &cursors](std::size_t replica) -> std::size_t {
+        std::stringstream stream(std::ios::in | std::ios::out | std::ios::binary);
+        source.changes_since(cursors[replica]).save(stream);
+        Tracked::delta_type delta;
+        delta.load(stream);
+        ordered_map::apply_delta(replicas[replica], delta);
+        cursors[replica] = delta.to;
+        return delta.erased.size() + delta.updated.size() + delta.appended.size();
+    };
+    std::uint32_t seed = 12345;
+    auto random        = [&seed](std::uint32_t bound) -> int {
+        seed = (seed * 1103515245U) + 12345U;
+        return static_cast<int>((seed >> 16U) % bound);
+    };
+    for (int round = 0; round < 2000; ++round) {
+        const int action      = random(100);
+        const std::string key = std::to_string(random(300));
+        if (action < 60) {
+            source.set(key, round);
+        } else if (action < 95) {
+            source.erase(key);
+        } else if (action < 98) {
+            source.sort(
+                [](const Table::list_entry_t &lhs, const Table::list_entry_t &rhs) { return lhs.second < rhs.second; });
+        } else if (action < 99) {
+            source.clear();
+        } else {
+            // The first replica is always in sync, so it can be forgotten.
+            source.forget_before(cursors[0]);
+        }
+        sync(0);
+        if ((round % 97) == 0) {
+            sync(1);
+        }
+        if (!std::equal(source.get().begin(), source.get().end(), replicas[0].begin()) ||
+            (source.size() != replicas[0].size())) {
+            std::cerr << "The replica diverged at round " << round << ".\n";
+            return 1;
+        }
+    }
+    sync(1);
+    if ((source.size() != replicas[1].size()) ||
+        !std::equal(source.get().begin(), source.get().end(), replicas[1].begin())) {
+        std::cerr << "The stale replica diverged.\n";
+        return 1;
+    }
+    // The cost of a sync follows the changes, not the size of the map.
+    for (int index = 0; index < 1000; ++index) {
+        source.set("bulk" + std::to_string(index), index);
+    }
+    sync(0);
+    source.set("bulk500", -1);
+    source.erase("bulk10");
+    if ((sync(0) != 2) || !check(replicas[0], "bulk500", -1) || (replicas[0].find("bulk10") != replicas[0].end())) {
+        std::cerr << "The delta is not proportional to the changes.\n";
+        return 1;
+    }
+    // An order which does not match the replica is rejected.
+    Tracked::delta_type mismatched;
+    mismatched.reordered = true;
+    mismatched.order.push_back("bulk500");
+    bool mismatch_thrown = false;
+    try {
+        ordered_map::apply_delta(replicas[0], mismatched);
+    } catch (const std::runtime_error &) {
+        mismatch_thrown = true;
+    }
+    if (!mismatch_thrown) {
+        std::cerr << "A mismatched order was applied.\n";
+        return 1;
+    }
+    return 0;
+}
+
+auto run_test_24() -> int
+{
+#if defined(__unix__) || defined(__APPLE__)
+    using Shared           = ordered_map::shared_ordered_map_t<int, long>;
+    const std::string name = "/ordered_map_test_24_" + std::to_string(::getpid());
+    Shared::remove(name);
+    Shared shared = Shared::create(name, 1024);
+    for (int index = 0; index < 100; ++index) {
+        shared.set(index, index);
+    }
+    // The child attaches to the segment by name, and writes concurrently with the parent.
+    pid_t child = ::fork();
+    if (child < 0) {
+        std::cerr << "Cannot fork.\n";
+        Shared::remove(name);
+        return 1;
+    }
+    if (child == 0) {
+        int status = 0;
+        try {
+            Shared attached = Shared::open(name);
+            long value      = 0;
+            if (!attached.find(50, value) || (value != 50)) {
+                status = 1;
+            }
+            for (int index = 100; index < 200; ++index) {
+                attached.set(index, -index);
+            }
+            attached.erase(0);
+        } catch (...) {
+            status = 1;
+        }
+        ::_exit(status);
+    }
+    for (int index = 1000; index < 1100; ++index) {
+        shared.set(index, index);
+    }
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+        std::cerr << "The child process failed.\n";
+        Shared::remove(name);
+        return 1;
+    }
+    long value = 0;
+    if ((shared.size() != 299) || shared.find(0, value) || !shared.find(150, value) || (value != -150)) {
+        std::cerr << "The changes of the child are not visible to the parent.\n";
+        Shared::remove(name);
+        return 1;
+    }
+    // Each process appended its own keys in order, and the erased node is reused.
+    std::vector<int> keys;
+    shared.for_each([&keys](const int &key, const long &) { keys.push_back(key); });
+    int last_child = 99, last_parent = 999;
+    for (std::size_t index = 0; index < keys.size(); ++index) {
+        int key  = keys[index];
+        bool bad = false;
+        if (index < 99) {
+            bad = key != static_cast<int>(index) + 1;
+        } else if (key < 1000) {
+            bad        = key != last_child + 1;
+            last_child = key;
+        } else {
+            bad         = key != last_parent + 1;
+            last_parent = key;
+        }
+        if (bad) {
+            std::cerr << "Wrong insertion order at " << index << ".\n";
+            Shared::remove(name);
+            return 1;
+        }
+    }
+    shared.set(0, 0);
+    if ((shared.size() != 300) || !shared.find(0, value) || (value != 0)) {
+        std::cerr << "Cannot insert after an erase.\n";
+        Shared::remove(name);
+        return 1;
+    }
+    Shared::remove(name);
+#endif
+    return 0;
+}
+
+auto run_test_25() -> int
+{
+    using Cow = ordered_map::cow_ordered_map_t<std::string, int>;
+    Cow live;
+    for (int index = 0; index < 100000; ++index) {
+        live.set(std::to_string(index), index);
+    }
+    const std::string path  = "ordered_map_test_25.bin";
+    std::future<void> saved = live.save_async(path);
+    // The live map keeps changing while the snapshot is written.
+    for (int index = 0; index < 1000; ++index) {
+        live.set(std::to_string(index), -index);
+        live.erase(std::to_string(50000 + index));
+        live.set("new" + std::to_string(index), index);
+    }
+    saved.get();
+    Table loaded;
+    {
+        std::ifstream stream(path, std::ios::binary);
+        loaded.load(stream);
+    }
+    std::remove(path.c_str());
+    if ((loaded.size() != 100000) || (loaded.find("0")->second != 0) || (loaded.find("999")->second != 999) ||
+        (loaded.find("50000") == loaded.end()) || (loaded.find("new0") != loaded.end())) {
+        std::cerr << "The snapshot is not the content of the map at the time of the call.\n";
+        return 1;
+    }
+    if ((live.size() != 100000) || (live.find("999")->second != -999) || (live.find("50000") != live.end())) {
+        std::cerr << "The live map lost its modifications.\n";
+        return 1;
+    }
+    // Errors are reported through the future.
+    std::future<void> failed = live.save_async("ordered_map_missing_directory/test_25.bin");
+    try {
+        failed.get();
+        std::cerr << "Saving to a missing directory succeeded.\n";
+        return 1;
+    } catch (const std::runtime_error &) {
+        // Expected.
+    }
+    return 0;
+}
+
+auto run_test_26() -> int
+{
+    using Metrics = ordered_map::ordered_map_t<std::string, int>;
+    Metrics table;
+    for (int index = 0; index < 20000; ++index) {
+        table.set("service.region-" + std::to_string(index / 5000) + ".zone-" + std::to_string((index / 500) % 10) +
+                      ".host-" + std::to_string((index / 50) % 10) + ".metric-" + std::to_string(index % 50),
+                  index);
+    }
+    std::stringstream plain;
+    table.save(plain);
+    ordered_map::front_coded_options_t options;
+    std::stringstream coded;
+    ordered_map::save_front_coded(table, coded, options);
+    options.compress = true;
+    std::stringstream compressed;
+    ordered_map::save_front_coded(table, compressed, options);
+    const std::size_t plain_size = plain.str().size();
+    if ((coded.str().size() * 4 > plain_size) || (compressed.str().size() >= coded.str().size())) {
+        std::cerr << "The keys are not compressed: " << plain_size << ", " << coded.str().size() << ", "
+                  << compressed.str().size() << ".\n";
+        return 1;
+    }
+    for (std::stringstream *stream : {&coded, &compressed}) {
+        Metrics loaded;
+        ordered_map::load_front_coded(*stream, loaded);
+        if ((loaded.size() != table.size()) || !std::equal(table.begin(), table.end(), loaded.begin())) {
+            std::cerr << "The loaded map is different.\n";
+            return 1;
+        }
+        // Random access decodes a single block.
+        stream->seekg(0);
+        ordered_map::front_coded_reader_t<int> reader(*stream);
+        std::string key;
+        int value = 0;
+        for (std::size_t position : {std::size_t(19999), std::size_t(0), std::size_t(7777), std::size_t(7778)}) {
+            if (!reader.at(position, key, value) || (key != table.at(position)->first) ||
+                (value != table.at(position)->second)) {
+                std::cerr << "Wrong entry at position " << position << ".\n";
+                return 1;
+            }
+        }
+        if ((reader.size() != table.size()) || reader.at(20000, key, value)) {
+            std::cerr << "Wrong number of entries.\n";
+            return 1;
+        }
+    }
+    // The compressor handles incompressible and highly repetitive data.
+    std::string random, repeated(100000, 'a');
+    for (int index = 0; index < 100000; ++index) {
+        random.push_back(static_cast<char>((index * 7919) ^ (index >> 3)));
+    }
+    for (const std::string *data : {&random, &repeated}) {
+        if (ordered_map::lz_decompress(ordered_map::lz_compress(*data), data->size()) != *data) {
+            std::cerr << "The compressor is not lossless.\n";
+            return 1;
+        }
+    }
+    if (ordered_map::lz_compress(repeated).size() > 100) {
+        std::cerr << "Repetitions are not compressed.\n";
+        return 1;
+    }
+    // Corrupted streams are rejected.
+    std::string corrupted = compressed.str();
+    corrupted[sizeof(ordered_map::detail::front_coded_header_t) + 1] ^= 0x55;
+    std::stringstream broken(corrupted);
+    Metrics untouched = table;
+    try {
+        ordered_map::load_front_coded(broken, untouched);
+        std::cerr << "A corrupted stream was accepted.\n";
+        return 1;
+    } catch (const std::runtime_error &) {
+        // Expected.
+    }
+    if ((untouched.size() != table.size()) || !std::equal(table.begin(), table.end(), untouched.begin())) {
+        std::cerr << "A failed load modified the map.\n";
+        return 1;
+    }
+    return 0;
+}
+
+auto run_test_27() -> int
+{
+    using Tiered = ordered_map::tiered_ordered_map_t<int, std::string>;
+    const std::string path = "ordered_map_test_27.values";
+    auto value_of          = [](int key, int round) {
+        return std::string(100, static_cast<char>('a' + (key % 26))) + std::to_string(key * round);
+    };
+    auto check = [&value_of](const Tiered &tiered, int round) {
+        int expected = 0;
+        for (Tiered::const_iterator it = tiered.begin(); it != tiered.end(); ++it, ++expected) {
+            while ((expected % 7) == 3) {
+                ++expected;
+            }
+            if ((it->first != expected) || (it->second != value_of(expected, (expected % 2 == 0) ? round : 1))) {
+                return false;
+            }
+        }
+        while ((expected % 7) == 3) {
+            ++expected;
+        }
+        return expected == 10000;
+    };
+    {
+        Tiered::options_t options;
+        options.memory_budget = 64U << 10U;
+        Tiered tiered(path, options);
+        for (int key = 0; key < 10000; ++key) {
+            tiered.set(key, value_of(key, 1));
+        }
+        for (int key = 3; key < 10000; key += 7) {
+            tiered.erase(key);
+        }
+        if ((tiered.resident() > options.memory_budget) || (tiered.spilled() == 0) || !check(tiered, 1)) {
+            std::cerr << "The cold values are not spilled correctly.\n";
+            return 1;
+        }
+        // Accessed values become resident, and the budget still holds.
+        for (int key = 9999; key >= 0; key -= 13) {
+            Tiered::const_iterator it = tiered.find(key);
+            if (((key % 7) == 3) ? (it != tiered.end()) : (it->second != value_of(key, 1))) {
+                std::cerr << "Wrong value for " << key << ".\n";
+                return 1;
+            }
+        }
+        for (int key = 0; key < 10000; key += 2) {
+            if ((key % 7) != 3) {
+                tiered.set(key, value_of(key, 2));
+            }
+        }
+        if ((tiered.resident() > options.memory_budget) || (tiered.garbage() == 0) || !check(tiered, 2)) {
+            std::cerr << "The updated values are not spilled correctly.\n";
+            return 1;
+        }
+        const std::uint64_t before = tiered.spilled();
+        tiered.compact();
+        if ((tiered.garbage() != 0) || (tiered.spilled() >= before) || !check(tiered, 2) ||
+            (tiered.find(8)->second != value_of(8, 2))) {
+            std::cerr << "The compaction lost some values.\n";
+            return 1;
+        }
+    }
+    if (std::ifstream(path).good()) {
+        std::cerr << "The file was not removed.\n";
+        return 1;
+    }
+#if defined(__linux__)
+    // When the file cannot be written, the values stay resident.
+    const std::string full_path = "ordered_map_test_27.full";
+    std::remove(full_path.c_str());
+    if (::symlink("/dev/full", full_path.c_str()) == 0) {
+        Tiered::options_t options;
+        options.memory_budget = 1024;
+        Tiered tiered(full_path, options);
+        bool thrown = false;
+        try {
+            for (int key = 0; key < 100; ++key) {
+                tiered.set(key, value_of(key, 1));
+            }
+        } catch (const std::runtime_error &) {
+            thrown = true;
+        }
+        if (!thrown || (tiered.resident() <= options.memory_budget) || (tiered.spilled() != 0) ||
+            (tiered.begin()->second != value_of(0, 1))) {
+            std::cerr << "A value was dropped without being written.\n";
+            return 1;
+        }
+    }
+#endif
+    return 0;
+}
+
+auto run_test_28() -> int
+{
+    using Tiered = ordered_map::tiered_ordered_map_t<int, std::string>;
+    using Entry  = std::pair<int, std::string>;
+    Tiered::options_t options;
+    options.memory_budget = 32U << 10U;
+    Tiered tiered("ordered_map_test_28.values", options);
+    for (int index = 0; index < 20000; ++index) {
+        int key = (index * 7919) % 20000;
+        tiered.set(key, "group-" + std::to_string(key % 97));
+    }
+    // Sort by value with a budget producing tens of runs, equal values keep the insertion order.
+    tiered.external_sort([](const Entry &lhs, const Entry &rhs) { return lhs.second < rhs.second; }, ".", 16U << 10U);
+    std::vector<Entry> sorted(tiered.begin(), tiered.end());
+    std::vector<Entry> expected;
+    for (int index = 0; index < 20000; ++index) {
+        int key = (index * 7919) % 20000;
+        expected.emplace_back(key, "group-" + std::to_string(key % 97));
+    }
+    std::stable_sort(expected.begin(), expected.end(),
+                     [](const Entry &lhs, const Entry &rhs) { return lhs.second < rhs.second; });
+    if (sorted != expected) {
+        std::cerr << "The external sort is wrong.\n";
+        return 1;
+    }
+    if ((tiered.find(1234)->second != "group-" + std::to_string(1234 % 97)) || (tiered.size() != 20000)) {
+        std::cerr << "The external sort broke the table.\n";
+        return 1;
+    }
+    // A tiny budget produces more runs than can be open at once, which are merged in passes.
+#if defined(__unix__) || defined(__APPLE__)
+    struct rlimit limit;
+    ::getrlimit(RLIMIT_NOFILE, &limit);
+    const rlimit previous_limit = limit;
+    limit.rlim_cur              = std::min<rlim_t>(limit.rlim_cur, 256);
+    ::setrlimit(RLIMIT_NOFILE, &limit);
+#endif
+    tiered.external_sort([](const Entry &lhs, const Entry &rhs) { return lhs.first < rhs.first; }, ".", 1);
+#if defined(__unix__) || defined(__APPLE__)
+    ::setrlimit(RLIMIT_NOFILE, &previous_limit);
+#endif
+    int next_key = 0;
+    for (Tiered::const_iterator it = tiered.begin(); it != tiered.end(); ++it, ++next_key) {
+        if (it->first != next_key) {
+            std::cerr << "The multi-pass external sort is wrong.\n";
+            return 1;
+        }
+    }
+    // A budget larger than the map sorts in memory.
+    tiered.external_sort([](const Entry &lhs, const Entry &rhs) { return lhs.first > rhs.first; }, ".", 64U << 20U);
+    int previous = 20000;
+    for (Tiered::const_iterator it = tiered.begin(); it != tiered.end(); ++it) {
+        if (it->first != previous - 1) {
+            std::cerr << "The in-memory sort is wrong.\n";
+            return 1;
+        }
+        previous = it->first;
+    }
+    return 0;
+}
+
 auto main(int argc, char *argv[]) -> int
 {
     if (argc == 2) {
@@ -203,6 +1796,78 @@ auto main(int argc, char *argv[]) -> int
         if (choice == 4) {
             return run_test_4();
         }
+        if (choice == 5) {
+            return run_test_5();
+        }
+        if (choice == 6) {
+            return run_test_6();
+        }
+        if (choice == 7) {
+            return run_test_7();
+        }
+        if (choice == 8) {
+            return run_test_8();
+        }
+        if (choice == 9) {
+            return run_test_9();
+        }
+        if (choice == 10) {
+            return run_test_10();
+        }
+        if (choice == 11) {
+            return run_test_11();
+        }
+        if (choice == 12) {
+            return run_test_12();
+        }
+        if (choice == 13) {
+            return run_test_13();
+        }
+        if (choice == 14) {
+            return run_test_14();
+        }
+        if (choice == 15) {
+            return run_test_15();
+        }
+        if (choice == 16) {
+            return run_test_16();
+        }
+        if (choice == 17) {
+            return run_test_17();
+        }
+        if (choice == 18) {
+            return run_test_18();
+        }
+        if (choice == 19) {
+            return run_test_19();
+        }
+        if (choice == 20) {
+            return run_test_20();
+        }
+        if (choice == 21) {
+            return run_test_21();
+        }
+        if (choice == 22) {
+            return run_test_22();
+        }
+        if (choice == 23) {
+            return run_test_23();
+        }
+        if (choice == 24) {
+            return run_test_24();
+        }
+        if (choice == 25) {
+            return run_test_25();
+        }
+        if (choice == 26) {
+            return run_test_26();
+        }
+        if (choice == 27) {
+            return run_test_27();
+        }
+        if (choice == 28) {
+            return run_test_28();
+        }
     }
     return 1;
 }